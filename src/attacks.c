@@ -0,0 +1,268 @@
+#include "attacks.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define NOT_FILE_A 0xFEFEFEFEFEFEFEFEULL
+#define NOT_FILE_H 0x7F7F7F7F7F7F7F7FULL
+#define NOT_FILE_AB 0xFCFCFCFCFCFCFCFCULL
+#define NOT_FILE_GH 0x3F3F3F3F3F3F3F3FULL
+
+/* - - - - - - - - KOGGE-STONE FILLS - - - - - - - - */
+
+#ifdef __AVX2__
+
+/*
+ * Lanes, from 0: north (8), east (1), north-east (9), north-west (7) going
+ * left, south, west, south-west, south-east going right. The mask of a lane
+ * keeps fills from wrapping around the board.
+ */
+U64 get_slider_attacks_setwise(U64 orth, U64 diag, U64 empty)
+{
+    const __m256i shift1 = _mm256_set_epi64x(7, 9, 1, 8);
+    const __m256i shift2 = _mm256_add_epi64(shift1, shift1);
+    const __m256i shift4 = _mm256_add_epi64(shift2, shift2);
+    const __m256i left_masks = _mm256_set_epi64x(
+        (long long)NOT_FILE_H, (long long)NOT_FILE_A, (long long)NOT_FILE_A, -1LL);
+    const __m256i right_masks = _mm256_set_epi64x(
+        (long long)NOT_FILE_A, (long long)NOT_FILE_H, (long long)NOT_FILE_H, -1LL);
+    const __m256i gen = _mm256_set_epi64x(diag, diag, orth, orth);
+    const __m256i e = _mm256_set1_epi64x(empty);
+    __m256i g, p, left, right;
+    __m128i x;
+
+    g = gen;
+    p = _mm256_and_si256(e, left_masks);
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, shift1)));
+    p = _mm256_and_si256(p, _mm256_sllv_epi64(p, shift1));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, shift2)));
+    p = _mm256_and_si256(p, _mm256_sllv_epi64(p, shift2));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, shift4)));
+    left = _mm256_and_si256(_mm256_sllv_epi64(g, shift1), left_masks);
+
+    g = gen;
+    p = _mm256_and_si256(e, right_masks);
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, shift1)));
+    p = _mm256_and_si256(p, _mm256_srlv_epi64(p, shift1));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, shift2)));
+    p = _mm256_and_si256(p, _mm256_srlv_epi64(p, shift2));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, shift4)));
+    right = _mm256_and_si256(_mm256_srlv_epi64(g, shift1), right_masks);
+
+    /* or of the 4 lanes */
+    left = _mm256_or_si256(left, right);
+    x = _mm_or_si128(_mm256_castsi256_si128(left), _mm256_extracti128_si256(left, 1));
+    x = _mm_or_si128(x, _mm_unpackhi_epi64(x, x));
+    return (U64)_mm_cvtsi128_si64(x);
+}
+
+U64 get_rook_attacks_setwise(U64 rooks, U64 empty)
+{
+    return get_slider_attacks_setwise(rooks, 0ULL, empty);
+}
+
+U64 get_bishop_attacks_setwise(U64 bishops, U64 empty)
+{
+    return get_slider_attacks_setwise(0ULL, bishops, empty);
+}
+
+#else
+
+/*
+ * Occluded fill of gen along one direction, then one more step: the cells
+ * attacked in that direction. mask clears the cells a step would wrap to.
+ */
+#define FILL_LEFT(gen, empty, shift, mask) \
+    _fill_left(gen, (empty) & (mask), shift, mask)
+#define FILL_RIGHT(gen, empty, shift, mask) \
+    _fill_right(gen, (empty) & (mask), shift, mask)
+
+static inline U64 _fill_left(U64 gen, U64 pro, int shift, U64 mask)
+{
+    gen |= pro & (gen << shift);
+    pro &= (pro << shift);
+    gen |= pro & (gen << (2 * shift));
+    pro &= (pro << (2 * shift));
+    gen |= pro & (gen << (4 * shift));
+    return (gen << shift) & mask;
+}
+
+static inline U64 _fill_right(U64 gen, U64 pro, int shift, U64 mask)
+{
+    gen |= pro & (gen >> shift);
+    pro &= (pro >> shift);
+    gen |= pro & (gen >> (2 * shift));
+    pro &= (pro >> (2 * shift));
+    gen |= pro & (gen >> (4 * shift));
+    return (gen >> shift) & mask;
+}
+
+/* 4 directions per type, where the AVX2 version fills the 8 at once */
+U64 get_rook_attacks_setwise(U64 rooks, U64 empty)
+{
+    return FILL_LEFT(rooks, empty, 8, ~0ULL)
+        | FILL_RIGHT(rooks, empty, 8, ~0ULL)
+        | FILL_LEFT(rooks, empty, 1, NOT_FILE_A)
+        | FILL_RIGHT(rooks, empty, 1, NOT_FILE_H);
+}
+
+U64 get_bishop_attacks_setwise(U64 bishops, U64 empty)
+{
+    return FILL_LEFT(bishops, empty, 9, NOT_FILE_A)
+        | FILL_RIGHT(bishops, empty, 9, NOT_FILE_H)
+        | FILL_LEFT(bishops, empty, 7, NOT_FILE_H)
+        | FILL_RIGHT(bishops, empty, 7, NOT_FILE_A);
+}
+
+U64 get_slider_attacks_setwise(U64 orth, U64 diag, U64 empty)
+{
+    return get_rook_attacks_setwise(orth, empty)
+        | get_bishop_attacks_setwise(diag, empty);
+}
+
+#endif
+
+U64 get_queen_attacks_setwise(U64 queens, U64 empty)
+{
+    return get_slider_attacks_setwise(queens, queens, empty);
+}
+
+/* - - - - - - - - LEAPERS - - - - - - - - */
+
+U64 get_knight_attacks_setwise(U64 knights)
+{
+    U64 l1 = (knights << 1) & NOT_FILE_A;
+    U64 l2 = (knights << 2) & NOT_FILE_AB;
+    U64 r1 = (knights >> 1) & NOT_FILE_H;
+    U64 r2 = (knights >> 2) & NOT_FILE_GH;
+    U64 h1 = l1 | r1;
+    U64 h2 = l2 | r2;
+    return (h1 << 16) | (h1 >> 16) | (h2 << 8) | (h2 >> 8);
+}
+
+U64 get_king_attacks_setwise(U64 kings)
+{
+    U64 sides = ((kings << 1) & NOT_FILE_A) | ((kings >> 1) & NOT_FILE_H);
+    U64 row = kings | sides;
+    return sides | (row << 8) | (row >> 8);
+}
+
+U64 get_pawn_attacks_setwise(U64 pawns, PieceColor color)
+{
+    if (color == PIECE_COLOR_WHITE) {
+        return ((pawns << 7) & NOT_FILE_H) | ((pawns << 9) & NOT_FILE_A);
+    }
+    return ((pawns >> 9) & NOT_FILE_H) | ((pawns >> 7) & NOT_FILE_A);
+}
+
+/* - - - - - - - - SIDES - - - - - - - - */
+
+static U64 _attacks_by(Bitboard *b, PieceColor color, U64 empty)
+{
+    int base = (color == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    U64 *p = &(b->position[base]);
+    U64 queens = p[WHITE_QUEEN - WHITE_PAWN];
+
+    return get_pawn_attacks_setwise(p[WHITE_PAWN - WHITE_PAWN], color)
+        | get_knight_attacks_setwise(p[WHITE_KNIGHT - WHITE_PAWN])
+        | get_king_attacks_setwise(p[WHITE_KING - WHITE_PAWN])
+        | get_slider_attacks_setwise(p[WHITE_ROOK - WHITE_PAWN] | queens,
+            p[WHITE_BISHOP - WHITE_PAWN] | queens, empty);
+}
+
+U64 bitboard_get_attacks_by(Bitboard *b, PieceColor color)
+{
+    return _attacks_by(b, color, ~bitboard_get_all_positions(b));
+}
+
+/* - - - - - - - - CACHED MAPS - - - - - - - - */
+
+#define _ATTACK_MAP_VALID(color) (1u << (color))
+#define _KING_DANGER_VALID(color) (4u << (color))
+
+/* the sets of the 6 piece types of color, then their union */
+static void _fill_attack_map(Bitboard *b, PieceColor color)
+{
+    int base = (color == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    U64 *p = &(b->position[base]);
+    U64 *a = &(b->piece_attacks[base]);
+    U64 empty = ~bitboard_get_all_positions(b);
+
+    a[WHITE_PAWN - WHITE_PAWN] = get_pawn_attacks_setwise(p[WHITE_PAWN - WHITE_PAWN], color);
+    a[WHITE_KNIGHT - WHITE_PAWN] = get_knight_attacks_setwise(p[WHITE_KNIGHT - WHITE_PAWN]);
+    a[WHITE_BISHOP - WHITE_PAWN] = get_bishop_attacks_setwise(p[WHITE_BISHOP - WHITE_PAWN], empty);
+    a[WHITE_ROOK - WHITE_PAWN] = get_rook_attacks_setwise(p[WHITE_ROOK - WHITE_PAWN], empty);
+    a[WHITE_QUEEN - WHITE_PAWN] = get_queen_attacks_setwise(p[WHITE_QUEEN - WHITE_PAWN], empty);
+    a[WHITE_KING - WHITE_PAWN] = get_king_attacks_setwise(p[WHITE_KING - WHITE_PAWN]);
+
+    b->attack_maps[color] = a[0] | a[1] | a[2] | a[3] | a[4] | a[5];
+    b->attack_maps_valid |= _ATTACK_MAP_VALID(color);
+}
+
+U64 bitboard_get_attack_map(Bitboard *b, PieceColor color)
+{
+    if (!(b->attack_maps_valid & _ATTACK_MAP_VALID(color))) {
+        _fill_attack_map(b, color);
+    }
+    return b->attack_maps[color];
+}
+
+U64 bitboard_get_piece_attacks(Bitboard *b, PieceType t)
+{
+    PieceColor color = (t < BLACK_PAWN) ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK;
+
+    if (!(b->attack_maps_valid & _ATTACK_MAP_VALID(color))) {
+        _fill_attack_map(b, color);
+    }
+    return b->piece_attacks[t];
+}
+
+/*
+ * The king is taken out of the occupancy, so that a slider checking it also
+ * attacks the cells behind it: the king can't escape along the line of the
+ * check. Without opponent sliders this is the plain attack map.
+ */
+U64 bitboard_get_king_danger(Bitboard *b, PieceColor color)
+{
+    PieceColor opponent = (color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+    int base = (opponent == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    U64 *p = &(b->position[base]);
+    U64 king = b->position[(color == PIECE_COLOR_WHITE) ? WHITE_KING : BLACK_KING];
+
+    if (!(b->attack_maps_valid & _KING_DANGER_VALID(color))) {
+        if (p[WHITE_BISHOP - WHITE_PAWN] | p[WHITE_ROOK - WHITE_PAWN] | p[WHITE_QUEEN - WHITE_PAWN]) {
+            b->king_danger_maps[color] =
+                _attacks_by(b, opponent, ~(bitboard_get_all_positions(b) & ~king));
+        }
+        else {
+            b->king_danger_maps[color] = bitboard_get_attack_map(b, opponent);
+        }
+        b->attack_maps_valid |= _KING_DANGER_VALID(color);
+    }
+    return b->king_danger_maps[color];
+}
+
+void bitboard_invalidate_attacks(Bitboard *b)
+{
+    b->attack_maps_valid = 0;
+}
+
+/*
+ * Attacks are symmetric: a piece attacks one of cells if a piece of the same
+ * kind (and opposite color, for pawns) placed on cells would attack it.
+ */
+U64 bitboard_get_attackers_to(Bitboard *b, U64 cells)
+{
+    U64 *p = b->position;
+    U64 rooks_queens = p[WHITE_ROOK] | p[BLACK_ROOK] | p[WHITE_QUEEN] | p[BLACK_QUEEN];
+    U64 bishops_queens = p[WHITE_BISHOP] | p[BLACK_BISHOP] | p[WHITE_QUEEN] | p[BLACK_QUEEN];
+    U64 empty = ~bitboard_get_all_positions(b);
+
+    return (get_pawn_attacks_setwise(cells, PIECE_COLOR_WHITE) & p[BLACK_PAWN])
+        | (get_pawn_attacks_setwise(cells, PIECE_COLOR_BLACK) & p[WHITE_PAWN])
+        | (get_knight_attacks_setwise(cells) & (p[WHITE_KNIGHT] | p[BLACK_KNIGHT]))
+        | (get_king_attacks_setwise(cells) & (p[WHITE_KING] | p[BLACK_KING]))
+        | (get_rook_attacks_setwise(cells, empty) & rooks_queens)
+        | (get_bishop_attacks_setwise(cells, empty) & bishops_queens);
+}
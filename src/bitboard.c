@@ -1,19 +1,197 @@
 #include "bitboard.h"
+#include "profile.h"
+#include "tables.h"
+#include "attacks.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+/* - - - - - - - - zobrist keys - - - - - - - - */
+
+/* the keys are generated with the other tables, see tables.h */
+
+/* key of the castling and en-passant rights only */
+U64 _zobrist_rights(Bitboard *b)
+{
+    U64 key = 0ULL;
+    if (b->white_castling_rights & MASK_WHITE_KING_LEFT_CASTLE) key ^= _zobrist_castling[0];
+    if (b->white_castling_rights & MASK_WHITE_KING_RIGHT_CASTLE) key ^= _zobrist_castling[1];
+    if (b->black_castling_rights & MASK_BLACK_KING_LEFT_CASTLE) key ^= _zobrist_castling[2];
+    if (b->black_castling_rights & MASK_BLACK_KING_RIGHT_CASTLE) key ^= _zobrist_castling[3];
+    if (b->enpassant_rights) {
+        key ^= _zobrist_enpassant[_FILE(_cell_of_bit(b->enpassant_rights))];
+    }
+    return key;
+}
+
+U64 bitboard_compute_hash(Bitboard *b)
+{
+    U64 key;
+    int cell;
+
+    key = _zobrist_rights(b);
+    for (cell=0; cell<64; cell++) {
+        if (b->piece_type[cell] < PIECE_TYPE_COUNT) {
+            key ^= _zobrist_piece[b->piece_type[cell]][cell];
+        }
+    }
+    return key;
+}
+
+U64 bitboard_key(Bitboard *b, PieceColor turn)
+{
+    return (turn == PIECE_COLOR_BLACK) 
+        ? b->hash ^ _zobrist_black_to_move
+        : b->hash;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* - - - - - - - - - - - - POOLS - - - - - - - - - - - - */
+
+#define POOL_DEFAULT_BOARDS_PER_SLAB 256
+#define POOL_ALIGNMENT 64
+
+/*
+ * Every board is followed by the pool it belongs to (NULL for boards from
+ * malloc), so destroy_bitboard knows where to give it back.
+ */
+#define _BOARD_OWNER(b) (*(BitboardPool **)((char *)(b) + sizeof(Bitboard)))
+#define _BOARD_SLOT_SIZE \
+    ((sizeof(Bitboard) + sizeof(BitboardPool *) + POOL_ALIGNMENT - 1) \
+        & ~(size_t)(POOL_ALIGNMENT - 1))
+
+typedef struct bitboard_slab_t {
+    struct bitboard_slab_t *next;
+    char *boards;
+} BitboardSlab;
+
+struct bitboard_pool_t {
+    unsigned int boards_per_slab;
+
+    /* boards are carved from current, slabs after it are unused */
+    BitboardSlab *slabs;
+    BitboardSlab *current;
+    unsigned int n_carved;
+
+    /* destroyed boards, linked through their first bytes */
+    void *free_list;
+
+    BitboardPoolStats stats;
+};
+
+__thread BitboardPool *_attached_pool = NULL;
+
+BitboardPool *create_bitboard_pool(unsigned int boards_per_slab)
+{
+    BitboardPool *p = malloc(sizeof(BitboardPool));
+    bzero(p, sizeof(BitboardPool));
+    p->boards_per_slab = boards_per_slab
+        ? boards_per_slab
+        : POOL_DEFAULT_BOARDS_PER_SLAB;
+    return p;
+}
+
+void destroy_bitboard_pool(BitboardPool *p)
+{
+    BitboardSlab *slab = p->slabs, *next;
+    while (slab) {
+        next = slab->next;
+        free(slab->boards);
+        free(slab);
+        slab = next;
+    }
+    free(p);
+}
+
+void bitboard_pool_attach(BitboardPool *p)
+{
+    _attached_pool = p;
+}
+
+BitboardPool *bitboard_pool_attached()
+{
+    return _attached_pool;
+}
+
+void bitboard_pool_reset(BitboardPool *p)
+{
+    p->current = p->slabs;
+    p->n_carved = 0;
+    p->free_list = NULL;
+    p->stats.in_use = 0;
+    p->stats.resets++;
+}
+
+void bitboard_pool_stats(BitboardPool *p, BitboardPoolStats *stats)
+{
+    memcpy(stats, &(p->stats), sizeof(BitboardPoolStats));
+}
+
+Bitboard *_pool_alloc(BitboardPool *p)
+{
+    Bitboard *b;
+
+    if (p->free_list) {
+        b = p->free_list;
+        p->free_list = *(void **)b;
+    }
+    else {
+        if (!p->current || p->n_carved == p->boards_per_slab) {
+            BitboardSlab *next = p->current ? p->current->next : p->slabs;
+            if (!next) {
+                void *boards;
+                if (posix_memalign(&boards, POOL_ALIGNMENT,
+                        (size_t)p->boards_per_slab * _BOARD_SLOT_SIZE)) {
+                    return NULL;
+                }
+                next = malloc(sizeof(BitboardSlab));
+                next->next = NULL;
+                next->boards = boards;
+                if (p->current) p->current->next = next;
+                else p->slabs = next;
+                p->stats.slabs++;
+            }
+            p->current = next;
+            p->n_carved = 0;
+        }
+        b = (Bitboard *)(p->current->boards + (size_t)p->n_carved++ * _BOARD_SLOT_SIZE);
+        _BOARD_OWNER(b) = p;
+    }
+
+    p->stats.allocations++;
+    if (++p->stats.in_use > p->stats.peak_in_use) {
+        p->stats.peak_in_use = p->stats.in_use;
+    }
+    return b;
+}
+
+/* a board with undefined content */
+Bitboard *_alloc_bitboard()
+{
+    Bitboard *b;
+
+    if (_attached_pool && (b = _pool_alloc(_attached_pool))) return b;
+
+    b = malloc(sizeof(Bitboard) + sizeof(BitboardPool *));
+    _BOARD_OWNER(b) = NULL;
+    return b;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - */
+
 Bitboard *create_blank_bitboard()
 {
-    Bitboard *b = malloc(sizeof(Bitboard));
+    Bitboard *b = _alloc_bitboard();
     bzero(b, sizeof(Bitboard));
     return b;
 }
 
 Bitboard *clone_bitboard(Bitboard *b)
 {
-    Bitboard * new_b = create_blank_bitboard();
+    PROFILE_SCOPE(PROFILE_CLONE_BITBOARD);
+    Bitboard * new_b = _alloc_bitboard();
     memcpy(new_b, b, sizeof(Bitboard));
     return new_b; 
 }
@@ -92,13 +270,228 @@ Bitboard *create_bitboard(void *chessboard_base, unsigned int chessboard_element
     if (BLACK_ROOK != b->piece_type[56]) b->black_castling_rights &= ~0x400000000000000ULL;
     if (BLACK_ROOK != b->piece_type[63]) b->black_castling_rights &= ~0x4000000000000000ULL;
 
+    b->hash = bitboard_compute_hash(b);
+    b->turn = PIECE_COLOR_WHITE;
+    b->fullmove_number = 1;
+
     /* return it */
     return b;
 }
 
+/* - - - - - - - - - - - - FEN - - - - - - - - - - - - */
+
+const char *_fen_pieces = "PNBRQKpnbrqk";
+
+PieceType _fen_piece_type(char ch)
+{
+    switch (ch) {
+        case 'P': return WHITE_PAWN;
+        case 'N': return WHITE_KNIGHT;
+        case 'B': return WHITE_BISHOP;
+        case 'R': return WHITE_ROOK;
+        case 'Q': return WHITE_QUEEN;
+        case 'K': return WHITE_KING;
+        case 'p': return BLACK_PAWN;
+        case 'n': return BLACK_KNIGHT;
+        case 'b': return BLACK_BISHOP;
+        case 'r': return BLACK_ROOK;
+        case 'q': return BLACK_QUEEN;
+        case 'k': return BLACK_KING;
+    }
+    return PIECE_NONE;
+}
+
+/*
+ * En-passant rights on the cell crossed by a pawn of color pushed moving by
+ * two, none if no enemy pawn can capture there. This way the same position
+ * has the same rights (and key) whether it comes from moves or from a FEN.
+ */
+U64 _enpassant_rights(Bitboard *b, int cell, PieceColor pushed)
+{
+    U64 capturers = (pushed == PIECE_COLOR_WHITE)
+        ? _pawn_attacks[PIECE_COLOR_WHITE][cell] & b->position[BLACK_PAWN]
+        : _pawn_attacks[PIECE_COLOR_BLACK][cell] & b->position[WHITE_PAWN];
+
+    return capturers ? (1ULL << cell) : 0x0ULL;
+}
+
+/* a number of the FEN, p is moved past it */
+int _fen_parse_number(const char **p, unsigned int *dest)
+{
+    unsigned int n = 0;
+    const char *start = *p;
+
+    while (**p >= '0' && **p <= '9') n = n * 10 + (*((*p)++) - '0');
+    *dest = n;
+    return *p != start;
+}
+
+int bitboard_set_fen(Bitboard *b, const char *fen)
+{
+    const char *p = fen;
+    int rank = RANK_8, file = FILE_A, cell;
+
+    bzero(b, sizeof(Bitboard));
+    for (cell=0; cell<64; cell++) b->piece_type[cell] = PIECE_NONE;
+
+    /* pieces, from a8 to h1 */
+    for (;; p++) {
+        if (*p >= '1' && *p <= '8') {
+            file += *p - '0';
+        }
+        else if (*p == '/' || *p == ' ') {
+            if (file != 8) return 0;
+            if (*p == ' ') break;
+            if (--rank < RANK_1) return 0;
+            file = FILE_A;
+        }
+        else {
+            PieceType t = _fen_piece_type(*p);
+            if (t == PIECE_NONE || file > FILE_H) return 0;
+
+            cell = _CELL(rank, file);
+            b->position[t] |= 1ULL << cell;
+            b->piece_type[cell] = t;
+            b->hash ^= _zobrist_piece[t][cell];
+            file++;
+        }
+        if (file > 8) return 0;
+    }
+    if (rank != RANK_1) return 0;
+
+    /* side to move */
+    p++;
+    if (*p == 'w') b->turn = PIECE_COLOR_WHITE;
+    else if (*p == 'b') b->turn = PIECE_COLOR_BLACK;
+    else return 0;
+    p++;
+
+    /* castling rights */
+    if (*(p++) != ' ') return 0;
+    if (*p == '-') {
+        p++;
+    }
+    else {
+        for (; *p && *p != ' '; p++) {
+            switch (*p) {
+                case 'K': b->white_castling_rights |= MASK_WHITE_KING_RIGHT_CASTLE; break;
+                case 'Q': b->white_castling_rights |= MASK_WHITE_KING_LEFT_CASTLE; break;
+                case 'k': b->black_castling_rights |= MASK_BLACK_KING_RIGHT_CASTLE; break;
+                case 'q': b->black_castling_rights |= MASK_BLACK_KING_LEFT_CASTLE; break;
+                default: return 0;
+            }
+        }
+    }
+    if (b->piece_type[_CELL_WHITE_KING_HOME] != WHITE_KING) b->white_castling_rights = 0x0ULL;
+    if (b->piece_type[_CELL_BLACK_KING_HOME] != BLACK_KING) b->black_castling_rights = 0x0ULL;
+    if (WHITE_ROOK != b->piece_type[0]) b->white_castling_rights &= ~MASK_WHITE_KING_LEFT_CASTLE;
+    if (WHITE_ROOK != b->piece_type[7]) b->white_castling_rights &= ~MASK_WHITE_KING_RIGHT_CASTLE;
+    if (BLACK_ROOK != b->piece_type[56]) b->black_castling_rights &= ~MASK_BLACK_KING_LEFT_CASTLE;
+    if (BLACK_ROOK != b->piece_type[63]) b->black_castling_rights &= ~MASK_BLACK_KING_RIGHT_CASTLE;
+
+    /* en-passant target square */
+    if (*(p++) != ' ') return 0;
+    if (*p == '-') {
+        p++;
+    }
+    else if (*p >= 'a' && *p <= 'h' && (p[1] == '3' || p[1] == '6')) {
+        cell = (p[1] - '1') * 8 + (p[0] - 'a');
+        b->enpassant_rights = _enpassant_rights(b, cell,
+            (p[1] == '3') ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK);
+        p += 2;
+    }
+    else {
+        return 0;
+    }
+
+    /* move counters, if any */
+    b->fullmove_number = 1;
+    if (*p == ' ') {
+        p++;
+        if (!_fen_parse_number(&p, &(b->halfmove_clock))) return 0;
+        if (*p == ' ') {
+            p++;
+            if (!_fen_parse_number(&p, &(b->fullmove_number))) return 0;
+        }
+    }
+    while (*p == ' ' || *p == '\n' || *p == '\r') p++;
+    if (*p) return 0;
+
+    /* pawns may move by two from their initial rank */
+    b->white_remaining_pawns_longsteps = _mask_rank(RANK_2);
+    b->black_remaining_pawns_longsteps = _mask_rank(RANK_7);
+    b->legal_move_iterator_lastcell = 0xFFFFULL;
+
+    b->hash ^= _zobrist_rights(b);
+    return 1;
+}
+
+Bitboard *bitboard_from_fen(const char *fen)
+{
+    Bitboard *b = _alloc_bitboard();
+    if (!bitboard_set_fen(b, fen)) {
+        destroy_bitboard(b);
+        return NULL;
+    }
+    return b;
+}
+
+void bitboard_to_fen(Bitboard *b, char *dest)
+{
+    char *p = dest;
+    int rank, file, empty;
+
+    for (rank=RANK_8; rank>=RANK_1; rank--) {
+        empty = 0;
+        for (file=FILE_A; file<=FILE_H; file++) {
+            PieceType t = b->piece_type[_CELL(rank, file)];
+            if (t >= PIECE_TYPE_COUNT) {
+                empty++;
+                continue;
+            }
+            if (empty) *(p++) = '0' + empty;
+            empty = 0;
+            *(p++) = _fen_pieces[t];
+        }
+        if (empty) *(p++) = '0' + empty;
+        if (rank != RANK_1) *(p++) = '/';
+    }
+
+    *(p++) = ' ';
+    *(p++) = (b->turn == PIECE_COLOR_BLACK) ? 'b' : 'w';
+    *(p++) = ' ';
+
+    if (b->white_castling_rights & MASK_WHITE_KING_RIGHT_CASTLE) *(p++) = 'K';
+    if (b->white_castling_rights & MASK_WHITE_KING_LEFT_CASTLE) *(p++) = 'Q';
+    if (b->black_castling_rights & MASK_BLACK_KING_RIGHT_CASTLE) *(p++) = 'k';
+    if (b->black_castling_rights & MASK_BLACK_KING_LEFT_CASTLE) *(p++) = 'q';
+    if (p[-1] == ' ') *(p++) = '-';
+    *(p++) = ' ';
+
+    if (b->enpassant_rights) {
+        int cell = _cell_of_bit(b->enpassant_rights);
+        *(p++) = 'a' + _FILE(cell);
+        *(p++) = '1' + _RANK(cell);
+    }
+    else {
+        *(p++) = '-';
+    }
+
+    sprintf(p, " %u %u", b->halfmove_clock, b->fullmove_number);
+}
+
 void destroy_bitboard(Bitboard *bitboard) 
 {
-	free(bitboard);
+    BitboardPool *p = _BOARD_OWNER(bitboard);
+
+    if (!p) {
+        free(bitboard);
+        return;
+    }
+    *(void **)bitboard = p->free_list;
+    p->free_list = bitboard;
+    p->stats.frees++;
+    p->stats.in_use--;
 }
 
 void init_move(Move *m) 
@@ -111,6 +504,15 @@ void init_move(Move *m)
     m->is_checkmate = 0;
 }
 
+int is_same_move(Move *a, Move *b)
+{
+    return a->from_file == b->from_file
+        && a->from_rank == b->from_rank
+        && a->to_file == b->to_file
+        && a->to_rank == b->to_rank
+        && a->promote_to == b->promote_to;
+}
+
 char *bitboard_piece_name(PieceType t)
 {
     char *piece_type_name[] = {
@@ -138,6 +540,158 @@ void print_move_fmt(Move *m, const char *fmt)
     );
 }
 
+void move_to_string(Move *m, char *dest)
+{
+    char promotion_repr[] = "pnbrqkpnbrqk";
+
+    dest[0] = m->from_file + 97;
+    dest[1] = m->from_rank + 49;
+    dest[2] = m->to_file + 97;
+    dest[3] = m->to_rank + 49;
+    if (m->promote_to < PIECE_TYPE_COUNT) {
+        dest[4] = promotion_repr[m->promote_to];
+        dest[5] = '\0';
+    }
+    else {
+        dest[4] = '\0';
+    }
+}
+
+int move_from_string(Bitboard *b, const char *str, Move *m)
+{
+    PieceType t;
+    int is_white;
+
+    init_move(m);
+    if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8'
+        || str[2] < 'a' || str[2] > 'h' || str[3] < '1' || str[3] > '8') {
+        return 0;
+    }
+    m->from_file = str[0] - 97;
+    m->from_rank = str[1] - 49;
+    m->to_file = str[2] - 97;
+    m->to_rank = str[3] - 49;
+
+    /* only the side to move can move, the promotion has its color */
+    t = get_piece_type(b, m->from_file, m->from_rank);
+    if (t >= PIECE_TYPE_COUNT) return 0;
+    is_white = t < BLACK_PAWN;
+    if (is_white != (b->turn == PIECE_COLOR_WHITE)) return 0;
+    switch (str[4]) {
+        case 'q': m->promote_to = is_white ? WHITE_QUEEN : BLACK_QUEEN; break;
+        case 'r': m->promote_to = is_white ? WHITE_ROOK : BLACK_ROOK; break;
+        case 'b': m->promote_to = is_white ? WHITE_BISHOP : BLACK_BISHOP; break;
+        case 'n': m->promote_to = is_white ? WHITE_KNIGHT : BLACK_KNIGHT; break;
+    }
+    return 1;
+}
+
+void move_to_san(Bitboard *b, Move *m, char *dest)
+{
+    char piece_repr[] = "PNBRQKPNBRQK";
+    PieceType t = get_piece_type(b, m->from_file, m->from_rank);
+    U64 to_mask = _mask_cell(m->to_file, m->to_rank);
+    int is_pawn = (t == WHITE_PAWN || t == BLACK_PAWN);
+    int is_capture = get_piece_type(b, m->to_file, m->to_rank) != PIECE_NONE
+        || (is_pawn && m->from_file != m->to_file);
+    char *p = dest;
+
+    if ((t == WHITE_KING || t == BLACK_KING)
+        && (m->to_file == m->from_file + 2 || m->from_file == m->to_file + 2)) {
+        strcpy(dest, (m->to_file > m->from_file) ? "O-O" : "O-O-O");
+        return;
+    }
+
+    if (is_pawn) {
+        if (is_capture) *(p++) = m->from_file + 97;
+    }
+    else {
+        /* other pieces of the same type reaching the target */
+        U64 others = b->position[t] & ~_mask_cell(m->from_file, m->from_rank);
+        int ambiguous = 0, same_file = 0, same_rank = 0;
+        Move other;
+        init_move(&other);
+
+        *(p++) = piece_repr[t];
+        while (others) {
+            others = get_next_cell_in(others, &other);
+            if (get_legal_moves(b, other.from_file, other.from_rank) & to_mask) {
+                ambiguous = 1;
+                if (other.from_file == m->from_file) same_file = 1;
+                if (other.from_rank == m->from_rank) same_rank = 1;
+            }
+        }
+        if (ambiguous && (!same_file || same_rank)) *(p++) = m->from_file + 97;
+        if (ambiguous && same_file) *(p++) = m->from_rank + 49;
+    }
+
+    if (is_capture) *(p++) = 'x';
+    *(p++) = m->to_file + 97;
+    *(p++) = m->to_rank + 49;
+    if (m->promote_to < PIECE_TYPE_COUNT) {
+        *(p++) = '=';
+        *(p++) = piece_repr[m->promote_to];
+    }
+    *p = '\0';
+}
+
+/* copies san without check marks, annotations and '=', 0-0 becomes O-O */
+void _normalize_san(const char *san, char *dest, int size)
+{
+    int n = 0;
+    for (; *san && n < size - 1; san++) {
+        if (*san == '+' || *san == '#' || *san == '!' || *san == '?'
+            || *san == '=') continue;
+        dest[n++] = (*san == '0') ? 'O' : *san;
+    }
+    dest[n] = '\0';
+}
+
+int move_from_san(Bitboard *b, const char *san, Move *m)
+{
+    PieceType promotions[4];
+    char wanted[16], candidate[16];
+    U64 own, targets;
+    Move from;
+    int i, n_promotions, is_white = (b->turn == PIECE_COLOR_WHITE);
+
+    promotions[0] = is_white ? WHITE_QUEEN : BLACK_QUEEN;
+    promotions[1] = is_white ? WHITE_ROOK : BLACK_ROOK;
+    promotions[2] = is_white ? WHITE_BISHOP : BLACK_BISHOP;
+    promotions[3] = is_white ? WHITE_KNIGHT : BLACK_KNIGHT;
+
+    _normalize_san(san, wanted, sizeof(wanted));
+    own = is_white ? bitboard_get_white_positions(b) : bitboard_get_black_positions(b);
+
+    init_move(&from);
+    while (own) {
+        own = get_next_cell_in(own, &from);
+        PieceType t = get_piece_type(b, from.from_file, from.from_rank);
+        targets = get_legal_moves(b, from.from_file, from.from_rank);
+
+        while (targets) {
+            int cell = _cell_of_bit(LS1B(targets));
+            targets &= targets - 1;
+
+            init_move(m);
+            m->from_file = from.from_file;
+            m->from_rank = from.from_rank;
+            m->to_file = _FILE(cell);
+            m->to_rank = _RANK(cell);
+
+            n_promotions = ((t == WHITE_PAWN && m->to_rank == RANK_8)
+                || (t == BLACK_PAWN && m->to_rank == RANK_1)) ? 4 : 1;
+            for (i=0; i<n_promotions; i++) {
+                if (n_promotions > 1) m->promote_to = promotions[i];
+                move_to_san(b, m, candidate);
+                _normalize_san(candidate, candidate, sizeof(candidate));
+                if (!strcmp(candidate, wanted)) return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 void print_move(Move *m)
 {
     print_move_fmt(m, "[M] %c%c - %c%c\n");
@@ -341,52 +895,18 @@ U64 get_bishop_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos)
 }
 
 U64 get_knight_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos) {
-    U64 pclip_a = piece_pos & _clear_file(FILE_A);
-    U64 pclip_h = piece_pos & _clear_file(FILE_H);
-    U64 pclip_b = piece_pos & _clear_file(FILE_B);
-    U64 pclip_g = piece_pos & _clear_file(FILE_G);
-    return (pclip_g & pclip_h) >> 6
-       | (pclip_b & pclip_a) >> 10
-       | (pclip_h) >> 15
-       | (pclip_a) >> 17
-       | (pclip_b & pclip_a) << 6
-       | (pclip_g & pclip_h) << 10
-       | (pclip_a) << 15
-       | (pclip_h) << 17;
+    return _knight_attacks[_CELL(rank, file)];
 }
 U64 get_black_king_attacks (Bitboard *b, FileType file, RankType rank, U64 piece_pos) {
-    U64 pclip_a = piece_pos & _clear_file(FILE_A);
-    U64 pclip_h = piece_pos & _clear_file(FILE_H);
-    return (pclip_a >> 1) 
-        | (pclip_a >> 9)
-        | (pclip_a << 7)
-        | (pclip_h << 1)
-        | (pclip_h << 9)
-        | (pclip_h >> 7)
-        | (piece_pos << 8)
-        | (piece_pos >> 8)
-        | b->black_castling_rights;
+    return _king_attacks[_CELL(rank, file)] | b->black_castling_rights;
 }
 U64 get_white_king_attacks (Bitboard *b, FileType file, RankType rank, U64 piece_pos) {
-    U64 pclip_a = piece_pos & _clear_file(FILE_A);
-    U64 pclip_h = piece_pos & _clear_file(FILE_H);
-    return (pclip_a >> 1) 
-       | (pclip_a >> 9)
-       | (pclip_a << 7)
-       | (pclip_h << 1)
-       | (pclip_h << 9)
-       | (pclip_h >> 7)
-       | (piece_pos << 8)
-       | (piece_pos >> 8)
-       | b->white_castling_rights;
+    return _king_attacks[_CELL(rank, file)] | b->white_castling_rights;
 }
 U64 get_black_pawn_attacks (Bitboard *b, FileType file, RankType rank, U64 piece_pos, int attacks_only) {
-    U64 pclip_a = piece_pos & _clear_file(FILE_A);
-    U64 pclip_h = piece_pos & _clear_file(FILE_H);
-
     /* pawn attacks */
     U64 piece_along_the_longstep = (bitboard_get_all_positions(b) & _mask_cell(file, rank-1));
-    U64 pawn_attacks_mask = (pclip_h >> 7) | (pclip_a >> 9);
+    U64 pawn_attacks_mask = _pawn_attacks[PIECE_COLOR_BLACK][_CELL(rank, file)];
     pawn_attacks_mask &= (bitboard_get_white_positions(b) | b->enpassant_rights); 
     
     if (attacks_only) {
@@ -405,12 +925,9 @@ U64 get_black_pawn_attacks (Bitboard *b, FileType file, RankType rank, U64 piece
     return result | pawn_attacks_mask;
 }
 U64 get_white_pawn_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos, int attacks_only) {
-    U64 pclip_a = piece_pos & _clear_file(FILE_A);
-    U64 pclip_h = piece_pos & _clear_file(FILE_H);
-
     /* pawn attacks */
     U64 piece_along_the_longstep = (bitboard_get_all_positions(b) & _mask_cell(file, rank+1));
-    U64 pawn_attacks_mask = (pclip_a << 7) | (pclip_h << 9);
+    U64 pawn_attacks_mask = _pawn_attacks[PIECE_COLOR_WHITE][_CELL(rank, file)];
     pawn_attacks_mask &= (bitboard_get_black_positions(b) | b->enpassant_rights);
 
     if (attacks_only) {
@@ -435,6 +952,7 @@ U64 get_queen_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos)
 
 U64 get_attacks_to_square(Bitboard *b, FileType file, RankType rank) 
 {
+       PROFILE_SCOPE(PROFILE_GET_ATTACKS_TO_SQUARE);
        U64 piece_pos = _mask_cell(file, rank);
        U64 knights, kings, bishops_queens, rooks_queens;
        knights        = b->position[WHITE_KNIGHT] | b->position[BLACK_KNIGHT];
@@ -459,15 +977,13 @@ U64 get_attacks_to_square(Bitboard *b, FileType file, RankType rank)
 }
 
 U64 bitboard_get_center_attackers(Bitboard *b) {
-    return get_attacks_to_square(b, FILE_D, RANK_4)
-        | get_attacks_to_square(b, FILE_D, RANK_5)
-        | get_attacks_to_square(b, FILE_E, RANK_4)
-        | get_attacks_to_square(b, FILE_E, RANK_5);
+    return bitboard_get_attackers_to(b, MASK_CENTER_4SQ);
 }
 
 
 U64 get_legal_moves(Bitboard *b, FileType file, RankType rank) 
 {
+    PROFILE_SCOPE(PROFILE_GET_LEGAL_MOVES);
     PieceType t = get_piece_type(b, file, rank);
     U64 piece_pos = b->position[t] & _mask_cell(file, rank);
     U64 result = 0ULL;            
@@ -514,6 +1030,35 @@ U64 get_legal_moves(Bitboard *b, FileType file, RankType rank)
     else
         result &= ~black_piece_positions;
     
+    /*
+     * King: it can't step on a cell attacked by the opponent, and castles
+     * only out of check, with nothing between the king and the rook, and
+     * without crossing an attacked cell.
+     */
+    if (t == WHITE_KING || t == BLACK_KING) {
+        int cell = _CELL(rank, file), target, rook_cell;
+        U64 danger = bitboard_get_king_danger(b,
+            is_white_piece ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK);
+        U64 rooks = b->position[is_white_piece ? WHITE_ROOK : BLACK_ROOK];
+        U64 occupancy = white_piece_positions | black_piece_positions;
+        U64 castling = result & ~_king_attacks[cell];
+
+        result &= _king_attacks[cell] & ~danger;
+        if (danger & piece_pos) return result;
+
+        while (castling) {
+            target = _cell_of_bit(LS1B(castling));
+            castling &= castling - 1;
+            rook_cell = (_FILE(target) == FILE_G) ? target + 1 : target - 2;
+            if ((rooks & (1ULL << rook_cell))
+                && !(occupancy & _between_masks[cell][rook_cell])
+                && !(danger & (_between_masks[cell][target] | (1ULL << target)))) {
+                result |= 1ULL << target;
+            }
+        }
+        return result;
+    }
+
     /*
      * Handle king being checked if piece moves. If king exists on the
      * chessboard, determine whether it is attached a priori or a
@@ -528,45 +1073,30 @@ U64 get_legal_moves(Bitboard *b, FileType file, RankType rank)
         king_cell = _cell_of_bit(king_position);
 
         // check if the king is currently checked (a priori)
-        king_attacked_priori = 
-            get_attacks_to_square(b, _FILE(king_cell), _RANK(king_cell))
-                & ( is_white_piece ? ~white_piece_positions
-                                   : ~black_piece_positions
-                );
-
-        // check if the king is attacked after removing the piece
-        b->position[t] &= ~piece_pos; // remove piece
-        king_attacked_posteriori = 
-            get_attacks_to_square(b, _FILE(king_cell), _RANK(king_cell))
-                & (is_white_piece ? ~white_piece_positions
-                                  : ~black_piece_positions
-                );
-        b->position[t] |= piece_pos; // put piece back
-    }
-
-
-    /*
-     * King Special case: we need to remove squares in which the king would be in check...
-     */
-    if (t == king_type) { 
-        Move m;
-        U64 actual_moves = result;
-
-        b->position[t] &= ~piece_pos; // remove piece
-        while (result) {
-            result = get_next_cell_in(result, &m);
-            U64 attackers = get_attacks_to_square(b, m.from_file, m.from_rank) 
-                & (is_white_piece ? ~white_piece_positions : ~black_piece_positions);
+        if (king_position & bitboard_get_attack_map(b,
+                is_white_piece ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE)) {
+            king_attacked_priori =
+                get_attacks_to_square(b, _FILE(king_cell), _RANK(king_cell))
+                    & ( is_white_piece ? ~white_piece_positions
+                                       : ~black_piece_positions
+                    );
+        }
 
-            if (attackers) {
-                // remove cell
-                actual_moves &= ~_mask_cell(m.from_file, m.from_rank);
-            }
+        // check if the king is attacked after removing the piece: only a
+        // piece on a line with the king can uncover an attack
+        if (!king_attacked_priori
+                && _line_masks[king_cell][_CELL(rank, file)]) {
+            b->position[t] &= ~piece_pos; // remove piece
+            king_attacked_posteriori =
+                get_attacks_to_square(b, _FILE(king_cell), _RANK(king_cell))
+                    & (is_white_piece ? ~white_piece_positions
+                                      : ~black_piece_positions
+                    );
+            b->position[t] |= piece_pos; // put piece back
         }
-        b->position[t] |= piece_pos; // put piece back
-        return actual_moves;
     }
 
+
     /*
      * Special case of king attacked a priori
      */
@@ -587,9 +1117,13 @@ U64 get_legal_moves(Bitboard *b, FileType file, RankType rank)
 
             king_attacked_from_cell = _CELL(m.from_rank, m.from_file);
             king_attacked_from_cell_mask = _mask_cell(m.from_file, m.from_rank);
-            inbetween_attacks |= 
-                _mask_between(king_attacked_from_cell, king_cell) 
-                | king_attacked_from_cell_mask;
+            inbetween_attacks |= king_attacked_from_cell_mask;
+
+            // only the check of a slider (on a line) can be blocked
+            if (_line_masks[king_attacked_from_cell][king_cell]) {
+                inbetween_attacks |=
+                    _between_masks[king_attacked_from_cell][king_cell];
+            }
 
             /*
              * Special case for en-passant check removal.
@@ -667,12 +1201,101 @@ int is_legal_move(Bitboard *b, Move *m)
     return !!(legal_moves & _mask_cell(m->to_file, m->to_rank));
 }
 
+int bitboard_is_in_check(Bitboard *b, PieceColor color)
+{
+    U64 king = b->position[(color == PIECE_COLOR_WHITE) ? WHITE_KING : BLACK_KING];
+    return !!(king & bitboard_get_attack_map(b,
+        (color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE));
+}
+
+int bitboard_has_legal_move(Bitboard *b, PieceColor color)
+{
+    U64 own = (color == PIECE_COLOR_WHITE)
+        ? bitboard_get_white_positions(b)
+        : bitboard_get_black_positions(b);
+    Move from;
+
+    init_move(&from);
+    while (own) {
+        own = get_next_cell_in(own, &from);
+        if (get_legal_moves(b, from.from_file, from.from_rank)) return 1;
+    }
+    return 0;
+}
+
+int bitboard_is_pseudo_legal(Bitboard *b, Move *m)
+{
+    int from = _CELL(m->from_rank, m->from_file);
+    int to = _CELL(m->to_rank, m->to_file);
+    PieceType t = b->piece_type[from];
+    U64 target = 1ULL << to;
+    U64 white = bitboard_get_white_positions(b);
+    U64 black = bitboard_get_black_positions(b);
+    U64 occupancy = white | black;
+    int promotes;
+
+    if (t == PIECE_NONE || from == to) return 0;
+    if (target & ((t < BLACK_PAWN) ? white : black)) return 0;
+
+    /* pawns reaching the last rank, and only them, promote to a piece of their color */
+    promotes = (t == WHITE_PAWN && m->to_rank == RANK_8)
+        || (t == BLACK_PAWN && m->to_rank == RANK_1);
+    if (promotes != (m->promote_to != PIECE_NONE)) return 0;
+    if (promotes && (m->promote_to <= t || m->promote_to >= t + (WHITE_KING - WHITE_PAWN))) {
+        return 0;
+    }
+
+    switch (t) {
+        case WHITE_KNIGHT:
+        case BLACK_KNIGHT:
+            return !!(_knight_attacks[from] & target);
+        case WHITE_BISHOP:
+        case BLACK_BISHOP:
+            return m->from_file != m->to_file && m->from_rank != m->to_rank
+                && _line_masks[from][to] && !(_between_masks[from][to] & occupancy);
+        case WHITE_ROOK:
+        case BLACK_ROOK:
+            return (m->from_file == m->to_file || m->from_rank == m->to_rank)
+                && !(_between_masks[from][to] & occupancy);
+        case WHITE_QUEEN:
+        case BLACK_QUEEN:
+            return _line_masks[from][to] && !(_between_masks[from][to] & occupancy);
+        case WHITE_KING:
+        case BLACK_KING:
+            if (_king_attacks[from] & target) return 1;
+            return !!(target & ((t == WHITE_KING) ? b->white_castling_rights : b->black_castling_rights))
+                && is_legal_move(b, m);
+        case WHITE_PAWN:
+            if (_pawn_attacks[PIECE_COLOR_WHITE][from] & target) {
+                return !!(target & (black | b->enpassant_rights));
+            }
+            if (to == from + 8) return !(target & occupancy);
+            return to == from + 16
+                && (b->white_remaining_pawns_longsteps & (1ULL << from))
+                && !((target | (target >> 8)) & occupancy);
+        case BLACK_PAWN:
+            if (_pawn_attacks[PIECE_COLOR_BLACK][from] & target) {
+                return !!(target & (white | b->enpassant_rights));
+            }
+            if (to == from - 8) return !(target & occupancy);
+            return to == from - 16
+                && (b->black_remaining_pawns_longsteps & (1ULL << from))
+                && !((target | (target << 8)) & occupancy);
+        default:
+            return 0;
+    }
+}
+
 void _perform_piece_move(Bitboard *b, Move *m)
 {
     PieceType t = get_piece_type(b, m->from_file, m->from_rank);
     PieceType ttarget = get_piece_type(b, m->to_file, m->to_rank);
     PieceType ttarget_new = (PIECE_NONE == m->promote_to) ? t : m->promote_to;
 
+    /* update the zobrist key */
+    b->hash ^= _zobrist_piece[t][_CELL(m->from_rank, m->from_file)]
+        ^ _zobrist_piece[ttarget_new][_CELL(m->to_rank, m->to_file)];
+
     /* move to position */
     b->position[t] &= (~_mask_cell(m->from_file, m->from_rank));       /* remove piece from original square */
     b->position[ttarget_new] |= (_mask_cell(m->to_file, m->to_rank));  /* place piece to target square */
@@ -680,6 +1303,7 @@ void _perform_piece_move(Bitboard *b, Move *m)
     /* the target piece type may be empty for example for en-passant captures */
     if (ttarget != PIECE_NONE) {
         b->position[ttarget] &= (~_mask_cell(m->to_file, m->to_rank)); /* clear from the capture piece in case */
+        b->hash ^= _zobrist_piece[ttarget][_CELL(m->to_rank, m->to_file)];
     }
     else {
         /* the piece simply moved or captured en-passant */
@@ -697,59 +1321,63 @@ void _perform_piece_move(Bitboard *b, Move *m)
 
 void bitboard_do_move(Bitboard *b, Move *m)
 {
+    PROFILE_SCOPE(PROFILE_BITBOARD_DO_MOVE);
     Move rook_move;
     PieceType t = get_piece_type(b, m->from_file, m->from_rank);
     PieceType ttarget = get_piece_type(b, m->to_file, m->to_rank);
     int cell_target = _CELL(m->to_rank, m->to_file);
 
     U64 piece_pos = (b->position[t] & _mask_cell(m->from_file, m->from_rank));
-    U64 longsteps_old;
+
+    /* rights are hashed again once the move is done */
+    b->hash ^= _zobrist_rights(b);
 
     /* clear enpassant chances (they'll be set later if necessary) */
     b->enpassant_rights = 0x0ULL;
 
     switch (t) {
         case WHITE_PAWN:
-            longsteps_old = b->white_remaining_pawns_longsteps;
-
             /* clear available longsteps for the pawn of this color */
             b->white_remaining_pawns_longsteps &= ~piece_pos;
 
-            if (longsteps_old != b->white_remaining_pawns_longsteps) {
-                /* 
-                 * This pawn may have moved of two positions! enable enpassant
-                 * chances by turning on the en-passant bit as if the pawn moved of one
-                 * position.
-                 */ 
-                b->enpassant_rights = (piece_pos << 8);
+            /* 
+             * The pawn moved of two positions: enable enpassant chances on
+             * the cell it crossed, if a black pawn can take it there.
+             */
+            if (m->to_rank - m->from_rank == 2) {
+                b->enpassant_rights = _enpassant_rights(b, cell_target - 8,
+                    PIECE_COLOR_WHITE);
             }
             
             /* 
              * If this pawn moved diagonally, and the target square is empty,
              * it was an en-passant capture! 
              */
-            if (m->to_file != m->from_file && ttarget == PIECE_NONE) {
+            if (m->to_file != m->from_file && ttarget == PIECE_NONE
+                && b->piece_type[cell_target - 8] == BLACK_PAWN) {
                 /* Clear out captured pawn behind the target*/
                 b->position[BLACK_PAWN] &= ~(_mask_cell(m->to_file, m->to_rank-1));
+                b->hash ^= _zobrist_piece[BLACK_PAWN][cell_target - 8];
                 b->piece_type[cell_target - 8] = PIECE_NONE;
                 b->pieces_addr[cell_target - 8] = NULL;
             }
             
             break;
         case BLACK_PAWN:
-            longsteps_old = b->black_remaining_pawns_longsteps;
-
             /* clear available longsteps for the pawn of this color */
             b->black_remaining_pawns_longsteps &= ~piece_pos;
 
-            if (longsteps_old != b->black_remaining_pawns_longsteps) {
-                /* enable enpassant chances (see comment for white). */ 
-                b->enpassant_rights = (piece_pos >> 8);
+            /* enable enpassant chances (see comment for white). */ 
+            if (m->from_rank - m->to_rank == 2) {
+                b->enpassant_rights = _enpassant_rights(b, cell_target + 8,
+                    PIECE_COLOR_BLACK);
             }
             
-            if (m->to_file != m->from_file && ttarget == PIECE_NONE) {
+            if (m->to_file != m->from_file && ttarget == PIECE_NONE
+                && b->piece_type[cell_target + 8] == WHITE_PAWN) {
                 /* Clear out captured pawn behind the target*/
                 b->position[WHITE_PAWN] &= ~(_mask_cell(m->to_file, m->to_rank+1));
+                b->hash ^= _zobrist_piece[WHITE_PAWN][cell_target + 8];
                 b->piece_type[cell_target + 8] = PIECE_NONE;
                 b->pieces_addr[cell_target + 8] = NULL;
             }
@@ -837,6 +1465,20 @@ void bitboard_do_move(Bitboard *b, Move *m)
 
     rook_move.promote_to = PIECE_NONE;
     _perform_piece_move(b, m);
+
+    b->hash ^= _zobrist_rights(b);
+
+    /* move counters, as in FEN */
+    if (t == WHITE_PAWN || t == BLACK_PAWN || ttarget != PIECE_NONE) {
+        b->halfmove_clock = 0;
+    }
+    else {
+        b->halfmove_clock++;
+    }
+    if (t >= BLACK_PAWN) b->fullmove_number++;
+    b->turn = (t < BLACK_PAWN) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+
+    bitboard_invalidate_attacks(b);
 }
 
 /*
@@ -1,12 +1,34 @@
 #include "engine.h"
 #include "bitboard.h"
+#include "attacks.h"
+#include "tables.h"
+#include "profile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define INFINITY 999999.9f
 #define DEPTH 7
+#define MAX_PLY ENGINE_MAX_PLY
+#define MAX_MOVES 256
+
+/* scores within MAX_PLY of +/-INFINITY are mate scores (see negaMax) */
+#define MATE_BOUND (INFINITY - MAX_PLY - 1)
+#define IS_MATE_SCORE(x) ((x) > MATE_BOUND && (x) <= INFINITY)
+
+/* root moves scoring within this of the best one are ties */
+#define TIE_MARGIN 0.01f
+
+/* quiet moves remembered per ply for the move ordering, see _score_killers */
+#define KILLERS_PER_PLY 2
+#define KILLER_SCORE 1000
+
+/* how often (in nodes) the clock is checked */
+#define TIME_CHECK_INTERVAL 1024
 
 #define NBITS_IN_INT sizeof(int) * 8
 
@@ -32,33 +54,95 @@ float _piece_score [] = {
 };
 
 float get_score_material_difference (Bitboard *b) {
-    // white material
-    float score_material_white = 0.0f;
-    U64 white_positions = bitboard_get_white_positions(b);
-    Move position;
-    PieceType piece_type;
-    while (white_positions) {
-        white_positions = get_next_cell_in(white_positions, &position);
-        piece_type = get_piece_type(b, position.from_file, position.from_rank);
-        score_material_white += _piece_score[piece_type];
-    }
-    
-    // black material
-    float score_material_black = 0.0f;
-    U64 black_positions = bitboard_get_black_positions(b);
-    while (black_positions) {
-        black_positions = get_next_cell_in(black_positions, &position);
-        piece_type = get_piece_type(b, position.from_file, position.from_rank);
-        score_material_black += _piece_score[piece_type];
+    float score_material = 0.0f;
+    int t;
+
+    // one popcount per piece type, black types follow the white ones
+    for (t=WHITE_PAWN; t<=WHITE_KING; t++) {
+        score_material += _piece_score[t] * (float)(_count_bits(b->position[t])
+            - _count_bits(b->position[t + BLACK_PAWN - WHITE_PAWN]));
     }
+    return score_material;
+}
 
-    return score_material_white - score_material_black;
+/* the weights evaluate_bitboard uses */
+void init_eval_weights(EvalWeights *w)
+{
+    w->material = 0.9f;
+    w->piece_count = 0.1f;
+    w->center_occupation = 0.2f;
+    w->center_attackers = 0.6f;
+    w->mobility_knight = 4.0f;
+    w->mobility_bishop = 3.0f;
+    w->mobility_rook = 2.0f;
+    w->mobility_queen = 1.0f;
+    w->king_zone_attacks = 6.0f;
 }
 
 /*
  * Return negative score if the player of turn is losing...
  */
 float evaluate_bitboard(Bitboard *b, PieceColor turn) {
+    EvalWeights w;
+    init_eval_weights(&w);
+    return evaluate_bitboard_weights(b, turn, &w);
+}
+
+/*
+ * Mobility of the pieces of color, from the attack sets of each piece type
+ * cached in the position.
+ */
+float _score_mobility(Bitboard *b, PieceColor color, EvalWeights *w) {
+    PieceType base = (color == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    U64 targets = ~((color == PIECE_COLOR_WHITE)
+        ? bitboard_get_white_positions(b) : bitboard_get_black_positions(b));
+    float score = 0.0f;
+
+    if (w->mobility_knight != 0.0f) {
+        score += w->mobility_knight * _count_bits(
+            bitboard_get_piece_attacks(b, base + WHITE_KNIGHT) & targets);
+    }
+    if (w->mobility_bishop != 0.0f) {
+        score += w->mobility_bishop * _count_bits(
+            bitboard_get_piece_attacks(b, base + WHITE_BISHOP) & targets);
+    }
+    if (w->mobility_rook != 0.0f) {
+        score += w->mobility_rook * _count_bits(
+            bitboard_get_piece_attacks(b, base + WHITE_ROOK) & targets);
+    }
+    if (w->mobility_queen != 0.0f) {
+        score += w->mobility_queen * _count_bits(
+            bitboard_get_piece_attacks(b, base + WHITE_QUEEN) & targets);
+    }
+    return score;
+}
+
+/* center cells attacked by each piece type of color, summed over the types */
+int _count_center_attacks(Bitboard *b, PieceColor color) {
+    PieceType t, base = (color == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    int n = 0;
+
+    for (t=base; t<=base + WHITE_KING; t++) {
+        n += _count_bits(bitboard_get_piece_attacks(b, t) & MASK_CENTER_4SQ);
+    }
+    return n;
+}
+
+/*
+ * Cells of the zone of the king of color (the king cell and its neighbours)
+ * attacked by the opponent, from the attack maps cached in the position.
+ */
+int _count_king_zone_attacks(Bitboard *b, PieceColor color) {
+    U64 king = b->position[(color == PIECE_COLOR_WHITE) ? WHITE_KING : BLACK_KING];
+    if (!king) return 0;
+
+    return _count_bits(bitboard_get_attack_map(b,
+            (color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE)
+        & (_king_attacks[_cell_of_bit(king)] | king));
+}
+
+float evaluate_bitboard_weights(Bitboard *b, PieceColor turn, EvalWeights *w) {
+    PROFILE_SCOPE(PROFILE_EVALUATE_BITBOARD);
     float white_or_black = 1.0f; // white
     if (turn == PIECE_COLOR_BLACK) {
         white_or_black = -1.0f; // black
@@ -72,20 +156,27 @@ float evaluate_bitboard(Bitboard *b, PieceColor turn) {
     float score_center_occupation = 
         (float)(bitboard_get_white_center_count(b) - bitboard_get_black_center_count(b)) * white_or_black;
 
-    U64 center_attackers = bitboard_get_center_attackers(b);
-    int n_white_attackers = center_attackers & ~bitboard_get_black_positions(b);
-    int n_black_attackers = center_attackers & ~bitboard_get_white_positions(b);
-
-    float score_center_attackers =
-        (float)(n_white_attackers - n_black_attackers) * white_or_black;
-
     float score = 
-          (0.9f * score_material)
-        + (0.1f * score_piece_count)
-        + (0.2f * score_center_occupation)
-        + (0.6f * score_center_attackers)
+          (w->material * score_material)
+        + (w->piece_count * score_piece_count)
+        + (w->center_occupation * score_center_occupation)
     ;
 
+    if (w->center_attackers != 0.0f) {
+        score += w->center_attackers * (float)(
+            _count_center_attacks(b, PIECE_COLOR_WHITE)
+            - _count_center_attacks(b, PIECE_COLOR_BLACK)) * white_or_black;
+    }
+
+    score += (_score_mobility(b, PIECE_COLOR_WHITE, w)
+        - _score_mobility(b, PIECE_COLOR_BLACK, w)) * white_or_black;
+
+    if (w->king_zone_attacks != 0.0f) {
+        score += w->king_zone_attacks * (float)(
+            _count_king_zone_attacks(b, PIECE_COLOR_BLACK)
+            - _count_king_zone_attacks(b, PIECE_COLOR_WHITE)) * white_or_black;
+    }
+
     return score;
 }
 
@@ -100,149 +191,1283 @@ float evaluate_one_move(Bitboard *b, Move *m, PieceColor turn) {
     return score;
 }
 
-float negaMax(Bitboard *b, Move *m, int depth, PieceColor turn, float alpha, float beta, Move move_history[]) {
-    if ( depth == 0 ) { 
-        return evaluate_one_move(b, m, turn);
+/* - - - - - - - - TRANSPOSITION TABLE - - - - - - - - */
+
+typedef enum {
+    TT_EXACT = 1,
+    TT_LOWER,   /* the score is a lower bound (fail high) */
+    TT_UPPER    /* the score is an upper bound (fail low) */
+} TTBound;
+
+/*
+ * The key is stored xor-ed with the data, so that an entry torn by two
+ * threads writing at the same time is just seen as a miss.
+ */
+typedef struct {
+    U64 key;
+    U64 data;
+} TTEntry;
+
+struct transposition_table_t {
+    TTEntry *entries;
+    U64 mask;
+};
+
+TranspositionTable *create_transposition_table(unsigned int size_mb)
+{
+    TranspositionTable *tt = malloc(sizeof(TranspositionTable));
+    U64 size = (U64)size_mb * 1024 * 1024;
+    U64 n_entries = 1;
+
+    if (size > ENGINE_MAX_MEMORY) size = ENGINE_MAX_MEMORY;
+
+    /* largest power of two that fits */
+    while (n_entries * 2 * sizeof(TTEntry) <= size) {
+        n_entries *= 2;
     }
 
+    tt->entries = calloc(n_entries, sizeof(TTEntry));
+    tt->mask = n_entries - 1;
+    return tt;
+}
 
-    float max = -INFINITY;
+void clear_transposition_table(TranspositionTable *tt)
+{
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(TTEntry));
+}
 
-   /*
-    * we need to understand what's the score after the current move
-    * ... so let's generate b1 = move(b)
-    */
-    Bitboard *b1 = clone_bitboard(b);
-    bitboard_do_move(b1, m);
+void destroy_transposition_table(TranspositionTable *tt)
+{
+    free(tt->entries);
+    free(tt);
+}
 
-    // invert turn and get ready to move all pieces of the opposite color
-    PieceColor next_turn = (turn == PIECE_COLOR_BLACK) 
-        ? PIECE_COLOR_WHITE
-        : PIECE_COLOR_BLACK;
+TranspositionTable *_default_tt = NULL;
+pthread_once_t _default_tt_once = PTHREAD_ONCE_INIT;
 
-    U64 piece_positions = (next_turn == PIECE_COLOR_WHITE) 
-        ?  bitboard_get_white_positions(b1)
-        :  bitboard_get_black_positions(b1);
+void _create_default_tt()
+{
+    _default_tt = create_transposition_table(ENGINE_DEFAULT_HASH_MB);
+}
 
-    Move next_move;
-    init_move(&next_move);
-    while (piece_positions) {
-        piece_positions = get_next_cell_in(piece_positions, &next_move);
-        reset_legal_move_iterator(b1);
-        while (get_next_legal_move(b1, &next_move)) {
+TranspositionTable *_get_default_tt()
+{
+    pthread_once(&_default_tt_once, _create_default_tt);
+    return _default_tt;
+}
 
-#ifndef NDEBUG
-            memcpy(&(move_history[DEPTH - depth]), &next_move, sizeof(Move));
-#endif
+void engine_set_hash_size(unsigned int size_mb)
+{
+    TranspositionTable *old = _get_default_tt();
+    _default_tt = create_transposition_table(size_mb);
+    destroy_transposition_table(old);
+}
+
+void engine_clear_hash()
+{
+    clear_transposition_table(_get_default_tt());
+}
 
-            // score the move with negaMax, but invert the resulting score
-            float score = -1 * negaMax(b1, &next_move, depth - 1, next_turn, -beta, -alpha, move_history);
+/* a move in 16 bits: from (6), to (6), promotion (4). 0 is no move. */
+unsigned int _pack_move(Move *m)
+{
+    return _CELL(m->from_rank, m->from_file)
+        | (_CELL(m->to_rank, m->to_file) << 6)
+        | ((m->promote_to & 0xF) << 12);
+}
 
-            if (score > alpha) {
-                alpha = score;
+void _unpack_move(unsigned int packed, Move *m)
+{
+    int from = packed & 0x3F;
+    int to = (packed >> 6) & 0x3F;
+    init_move(m);
+    m->from_file = _FILE(from);
+    m->from_rank = _RANK(from);
+    m->to_file = _FILE(to);
+    m->to_rank = _RANK(to);
+    m->promote_to = (packed >> 12) & 0xF;
+}
 
-#ifndef NDEBUG
-                if (depth == 1) {
-                    int i;
-                    for (i=0; i < DEPTH; i++) {
-                        print_move_fmt(&(move_history[i]), "[%c%c -> %c%c] ");
-                    }
-                    printf("%f\n", score);
+/* mate scores are stored relative to the node, not to the root */
+float _score_to_tt(float score, int ply)
+{
+    if (IS_MATE_SCORE(score)) return score + ply;
+    if (IS_MATE_SCORE(-score)) return score - ply;
+    return score;
+}
+
+float _score_from_tt(float score, int ply)
+{
+    if (IS_MATE_SCORE(score)) return score - ply;
+    if (IS_MATE_SCORE(-score)) return score + ply;
+    return score;
+}
+
+void tt_store(TranspositionTable *tt, U64 key, int depth, float score, 
+    TTBound bound, Move *best, int ply)
+{
+    TTEntry *e = &(tt->entries[key & tt->mask]);
+    union { float f; unsigned int u; } s;
+    U64 data;
+
+    s.f = _score_to_tt(score, ply);
+    data = (U64)s.u
+        | ((U64)(best ? _pack_move(best) : 0) << 32)
+        | ((U64)(depth & 0xFF) << 48)
+        | ((U64)bound << 56);
+
+    e->key = key ^ data;
+    e->data = data;
+}
+
+/* returns 1 and fills the fields if the position is in the table */
+int tt_probe(TranspositionTable *tt, U64 key, int *depth, float *score, 
+    TTBound *bound, unsigned int *packed_move, int ply)
+{
+    TTEntry *e = &(tt->entries[key & tt->mask]);
+    U64 data = e->data;
+    union { float f; unsigned int u; } s;
+
+    if ((e->key ^ data) != key || !data) return 0;
+
+    s.u = (unsigned int)(data & 0xFFFFFFFFULL);
+    *score = _score_from_tt(s.f, ply);
+    *packed_move = (data >> 32) & 0xFFFF;
+    *depth = (data >> 48) & 0xFF;
+    *bound = (data >> 56) & 0xFF;
+    return 1;
+}
+
+/* - - - - - - - - SEARCH - - - - - - - - */
+
+struct search_t {
+    Bitboard *board;
+    PieceColor turn;
+    SearchOptions options;
+    TranspositionTable *tt;
+    EvalWeights weights;
+    unsigned int seed;          /* of the tie-break between root moves */
+
+    volatile int stop;
+    volatile int pondering;
+    volatile long long start_ms;
+
+    /* helpers share the table with the main search, and stop with it */
+    Search *main;
+    Search **helpers;
+    int start_depth;
+
+    unsigned long long nodes;
+    SearchResult result;
+    pthread_t thread;
+
+    /* keys of the game before the root, then of the line searched, by ply */
+    U64 *history;
+    int history_length;
+    U64 keys[MAX_PLY];
+
+    /* quiet moves that caused a cutoff at each ply, packed, latest first */
+    unsigned int killers[MAX_PLY][KILLERS_PER_PLY];
+
+    /* triangular table, pv[ply] is the line found from ply onwards */
+    Move pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+
+    PVLine *root_moves;
+    int n_root_moves;
+
+    /* best lines of the last completed iteration, with multipv */
+    PVLine *lines;
+    int n_lines;
+};
+
+long long _now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int _should_stop(Search *s)
+{
+    if (s->stop) return 1;
+    if (s->main) {
+        s->stop = s->main->stop;
+        return s->stop;
+    }
+    if (s->pondering || s->options.infinite) return 0;
+
+    if (s->options.nodes && s->nodes >= s->options.nodes) {
+        s->stop = 1;
+    }
+    else if (s->options.movetime && !(s->nodes % TIME_CHECK_INTERVAL)
+        && _now_ms() - s->start_ms >= s->options.movetime) {
+        s->stop = 1;
+    }
+    return s->stop;
+}
+
+float search_stats_first_move_cutoff_rate(SearchStats *stats)
+{
+    if (!stats->cutoffs) return 0.0f;
+    return (float)stats->first_move_cutoffs / stats->cutoffs;
+}
+
+float search_stats_branching_factor(SearchStats *stats)
+{
+    int d = stats->depth;
+    if (d < 2 || !stats->depth_nodes[d - 1]) return 0.0f;
+    return (float)stats->depth_nodes[d] / stats->depth_nodes[d - 1];
+}
+
+void merge_search_stats(SearchStats *dest, SearchStats *src)
+{
+    dest->nodes += src->nodes;
+    dest->qnodes += src->qnodes;
+    dest->cutoffs += src->cutoffs;
+    dest->first_move_cutoffs += src->first_move_cutoffs;
+    dest->tt_probes += src->tt_probes;
+    dest->tt_hits += src->tt_hits;
+    dest->tt_cutoffs += src->tt_cutoffs;
+    dest->movegen_calls += src->movegen_calls;
+    dest->eval_calls += src->eval_calls;
+}
+
+/* the move at ply is followed by the line found at ply + 1 */
+void _update_pv(Search *s, int ply, Move *m)
+{
+    int next_length = s->pv_length[ply + 1];
+    memcpy(&(s->pv[ply][ply]), m, sizeof(Move));
+    if (next_length > ply + 1) {
+        memcpy(&(s->pv[ply][ply + 1]), &(s->pv[ply + 1][ply + 1]), 
+            (next_length - ply - 1) * sizeof(Move));
+        s->pv_length[ply] = next_length;
+    }
+    else {
+        s->pv_length[ply] = ply + 1;
+    }
+}
+
+PieceColor _opposite(PieceColor turn)
+{
+    return (turn == PIECE_COLOR_BLACK) ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK;
+}
+
+/*
+ * Fills moves with the legal moves of the player of turn, returns how many.
+ * Pawns reaching the last rank generate one move per promotion piece.
+ */
+int _generate_moves(Bitboard *b, PieceColor turn, Move *moves, int captures_only)
+{
+    U64 own, opponent, targets, target;
+    Move from;
+    int n = 0;
+    int is_white = (turn == PIECE_COLOR_WHITE);
+    PieceType t, promotions[4];
+
+    own = is_white ? bitboard_get_white_positions(b) : bitboard_get_black_positions(b);
+    opponent = is_white ? bitboard_get_black_positions(b) : bitboard_get_white_positions(b);
+
+    promotions[0] = is_white ? WHITE_QUEEN : BLACK_QUEEN;
+    promotions[1] = is_white ? WHITE_KNIGHT : BLACK_KNIGHT;
+    promotions[2] = is_white ? WHITE_ROOK : BLACK_ROOK;
+    promotions[3] = is_white ? WHITE_BISHOP : BLACK_BISHOP;
+
+    init_move(&from);
+    while (own) {
+        own = get_next_cell_in(own, &from);
+        t = get_piece_type(b, from.from_file, from.from_rank);
+        targets = get_legal_moves(b, from.from_file, from.from_rank);
+        if (captures_only) {
+            targets &= (t == WHITE_PAWN || t == BLACK_PAWN)
+                ? opponent | b->enpassant_rights
+                : opponent;
+        }
+        while (targets) {
+            target = LS1B(targets);
+            targets &= ~target;
+
+            int cell = _cell_of_bit(target);
+            Move *m = &(moves[n]);
+            init_move(m);
+            m->from_file = from.from_file;
+            m->from_rank = from.from_rank;
+            m->to_file = _FILE(cell);
+            m->to_rank = _RANK(cell);
+
+            if ((t == WHITE_PAWN && m->to_rank == RANK_8)
+                || (t == BLACK_PAWN && m->to_rank == RANK_1)) {
+                int i;
+                for (i=0; i<4; i++) {
+                    memcpy(&(moves[n + i]), m, sizeof(Move));
+                    moves[n + i].promote_to = promotions[i];
                 }
-#endif
+                n += 4;
             }
-
-            if (beta <= alpha) {
-                destroy_bitboard(b1);
-                return alpha;
+            else {
+                n++;
             }
         }
     }
+    return n;
+}
 
+/* - - - - - - - - STATIC EXCHANGE - - - - - - - - */
 
+#define SEE_MAX_CAPTURES 32
+
+/* the least valuable of attackers of color, 0 if none */
+U64 _least_valuable_attacker(Bitboard *b, U64 attackers, PieceColor color,
+    PieceType *t)
+{
+    PieceType first = (color == PIECE_COLOR_WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    U64 pieces;
+    for (*t=first; *t<=first + (WHITE_KING - WHITE_PAWN); (*t)++) {
+        pieces = attackers & b->position[*t];
+        if (pieces) return LS1B(pieces);
+    }
+    return 0ULL;
+}
+
+int bitboard_see(Bitboard *b, Move *m)
+{
+    int gain[SEE_MAX_CAPTURES], d = 0;
+    U64 to = _mask_cell(m->to_file, m->to_rank);
+    U64 from = _mask_cell(m->from_file, m->from_rank);
+    U64 occupancy = bitboard_get_all_positions(b);
+    U64 rooks_queens = b->position[WHITE_ROOK] | b->position[BLACK_ROOK]
+        | b->position[WHITE_QUEEN] | b->position[BLACK_QUEEN];
+    U64 bishops_queens = b->position[WHITE_BISHOP] | b->position[BLACK_BISHOP]
+        | b->position[WHITE_QUEEN] | b->position[BLACK_QUEEN];
+    PieceType t = get_piece_type(b, m->from_file, m->from_rank);
+    PieceType victim = get_piece_type(b, m->to_file, m->to_rank);
+    PieceColor color = (t < BLACK_PAWN) ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK;
+    U64 attackers = get_attacks_to_square(b, m->to_file, m->to_rank);
+    int on_target;
+
+    if (victim != PIECE_NONE) {
+        gain[0] = (int)_piece_score[victim];
+    }
+    else if ((t == WHITE_PAWN || t == BLACK_PAWN) && (to & b->enpassant_rights)) {
+        gain[0] = (int)_piece_score[WHITE_PAWN];
+        occupancy &= ~((color == PIECE_COLOR_WHITE) ? to >> 8 : to << 8);
+    }
+    else {
+        gain[0] = 0;
+    }
+
+    /* value of the piece standing on the target cell, to be captured next */
+    on_target = (int)_piece_score[t];
+    if (m->promote_to != PIECE_NONE) {
+        gain[0] += (int)(_piece_score[m->promote_to] - _piece_score[t]);
+        on_target = (int)_piece_score[m->promote_to];
+    }
+
+    while (from && d < SEE_MAX_CAPTURES - 1) {
+        d++;
+        gain[d] = on_target - gain[d - 1];
+        if ((-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]) < 0) break;
+
+        /* the piece that captured leaves its cell, uncovering x-rays */
+        attackers &= ~from;
+        occupancy &= ~from;
+        attackers |= ((get_rook_attacks_setwise(to, ~occupancy) & rooks_queens)
+            | (get_bishop_attacks_setwise(to, ~occupancy) & bishops_queens))
+            & occupancy;
+
+        color = (color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+        from = _least_valuable_attacker(b, attackers, color, &t);
+        if (from) on_target = (int)_piece_score[t];
+    }
+
+    while (--d) {
+        gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+    }
+    return gain[0];
+}
+
+/*
+ * Higher is searched first: captures (MVV-LVA), quiet moves, then captures
+ * losing material, scored by their (negative) static exchange. Only captures
+ * of a less valuable piece can lose material. The hash move is not scored, it
+ * is staged before the moves are generated (see _stage_hash_move).
+ */
+void _score_moves(Bitboard *b, Move *moves, int n, int *scores)
+{
+    int i, see;
+    PieceType victim, attacker;
+    for (i=0; i<n; i++) {
+        victim = get_piece_type(b, moves[i].to_file, moves[i].to_rank);
+        attacker = get_piece_type(b, moves[i].from_file, moves[i].from_rank);
+        if (victim == PIECE_NONE) {
+            scores[i] = 0;
+        }
+        else if (_piece_score[victim] < _piece_score[attacker]
+                && (see = bitboard_see(b, &(moves[i]))) < 0) {
+            scores[i] = see;
+            continue;
+        }
+        else {
+            scores[i] = (int)_piece_score[victim] * 16 - (attacker % 6);
+        }
+        if (moves[i].promote_to != PIECE_NONE) {
+            scores[i] += (int)_piece_score[moves[i].promote_to];
+        }
+    }
+}
+
+/* moves the best scoring move among [i, n) to position i */
+void _pick_move(Move *moves, int *scores, int i, int n)
+{
+    int k, best = i;
+    Move tmp_move;
+    int tmp_score;
+    for (k=i+1; k<n; k++) {
+        if (scores[k] > scores[best]) best = k;
+    }
+    if (best != i) {
+        memcpy(&tmp_move, &(moves[i]), sizeof(Move));
+        memcpy(&(moves[i]), &(moves[best]), sizeof(Move));
+        memcpy(&(moves[best]), &tmp_move, sizeof(Move));
+        tmp_score = scores[i];
+        scores[i] = scores[best];
+        scores[best] = tmp_score;
+    }
+}
+
+/*
+ * Only captures are searched, so that the position is evaluated when it is
+ * quiet.
+ */
+float quiesce(Search *s, Bitboard *b, int ply, PieceColor turn, float alpha, float beta)
+{
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES];
+    int n_moves, i;
+
+    s->pv_length[ply] = ply;
+
+    if (_should_stop(s)) return 0.0f;
+    s->nodes++;
+    s->result.stats.qnodes++;
+
+    // checkmate or stalemate, even at the horizon
+    if (!bitboard_has_legal_move(b, turn)) {
+        return bitboard_is_in_check(b, turn) ? -INFINITY + ply : 0.0f;
+    }
+
+    // evaluations must never be taken for mate scores
+    s->result.stats.eval_calls++;
+    float stand_pat = evaluate_bitboard_weights(b, turn, &(s->weights));
+    if (stand_pat > MATE_BOUND - 1) stand_pat = MATE_BOUND - 1;
+    if (stand_pat < -MATE_BOUND + 1) stand_pat = -MATE_BOUND + 1;
+    if (stand_pat >= beta || ply >= MAX_PLY - 1) {
+        return stand_pat;
+    }
+    if (stand_pat > alpha) {
+        alpha = stand_pat;
+    }
+
+    s->result.stats.movegen_calls++;
+    n_moves = _generate_moves(b, turn, moves, 1);
+    _score_moves(b, moves, n_moves, scores);
+
+    for (i=0; i<n_moves; i++) {
+        _pick_move(moves, scores, i, n_moves);
+
+        // the remaining captures all lose material
+        if (scores[i] < 0) break;
+
+        Bitboard *b1 = clone_bitboard(b);
+        bitboard_do_move(b1, &(moves[i]));
+        float score = -1 * quiesce(s, b1, ply + 1, _opposite(turn), -beta, -alpha);
+        destroy_bitboard(b1);
+
+        if (s->stop) return 0.0f;
+
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (beta <= alpha) {
+            return alpha;
+        }
+    }
+    return alpha;
+}
+
+/*
+ * After an exact hash hit, the principal variation is rebuilt by following
+ * the hash moves, for at most depth moves.
+ */
+void _pv_from_tt(Search *s, Bitboard *b, PieceColor turn, int ply, 
+    unsigned int tt_move, int depth)
+{
+    int tt_depth, length = ply;
+    float tt_score;
+    TTBound tt_bound;
+    Move m;
+    Bitboard *b1 = clone_bitboard(b);
+
+    while (tt_move && depth-- > 0 && length < MAX_PLY) {
+        _unpack_move(tt_move, &m);
+        if (!is_legal_move(b1, &m)) break;
+
+        memcpy(&(s->pv[ply][length++]), &m, sizeof(Move));
+        bitboard_do_move(b1, &m);
+        turn = _opposite(turn);
+
+        if (!tt_probe(s->tt, bitboard_key(b1, turn), &tt_depth, &tt_score, 
+                &tt_bound, &tt_move, ply)) {
+            break;
+        }
+    }
+    s->pv_length[ply] = length;
     destroy_bitboard(b1);
+}
+
+/*
+ * Fifty moves without a capture or a pawn move, or a position already met
+ * (in the line searched or in the game before it) are draws: the search does
+ * not go into the cycle again. Repetitions can only go back to the last
+ * capture or pawn move, halfmove_clock plies ago, with the same side to move.
+ * A mate given on the last of the fifty moves is still a mate.
+ */
+int _is_draw(Search *s, Bitboard *b, int ply, PieceColor turn)
+{
+    int back, i;
+
+    if (b->halfmove_clock >= 100
+        && (!bitboard_is_in_check(b, turn) || bitboard_has_legal_move(b, turn))) {
+        return 1;
+    }
+
+    for (back=4; back<=(int)b->halfmove_clock; back+=2) {
+        i = ply - back;
+        if (i >= 0) {
+            if (s->keys[i] == s->keys[ply]) return 1;
+        }
+        else if (s->history_length + i >= 0) {
+            if (s->history[s->history_length + i] == s->keys[ply]) return 1;
+        }
+        else {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* - - - - - - - - STAGED MOVES - - - - - - - - */
+
+/*
+ * The hash move, if it is a pseudo-legal move of a piece of turn: it is
+ * searched before generating the moves, which a cutoff then saves. Returns
+ * the number of moves put in moves (0 or 1).
+ */
+int _stage_hash_move(Bitboard *b, PieceColor turn, unsigned int tt_move,
+    Move *moves)
+{
+    PieceType t;
+
+    if (!tt_move) return 0;
+    _unpack_move(tt_move, moves);
+    t = get_piece_type(b, moves->from_file, moves->from_rank);
+    if (t == PIECE_NONE || (t < BLACK_PAWN) != (turn == PIECE_COLOR_WHITE)) return 0;
+    return bitboard_is_pseudo_legal(b, moves);
+}
+
+/*
+ * Drops from the n_generated moves following the n_staged ones those already
+ * staged, returns how many are left.
+ */
+int _remove_staged(Move *moves, int n_staged, int n_generated)
+{
+    int i, k, n = 0;
+    Move *generated = moves + n_staged;
+
+    for (i=0; i<n_generated; i++) {
+        for (k=0; k<n_staged; k++) {
+            if (is_same_move(&(generated[i]), &(moves[k]))) break;
+        }
+        if (k < n_staged) continue;
+        if (n != i) memcpy(&(generated[n]), &(generated[i]), sizeof(Move));
+        n++;
+    }
+    return n;
+}
+
+/* killers are searched after the winning captures, before other quiet moves */
+void _score_killers(Search *s, int ply, Move *moves, int n, int *scores)
+{
+    int i, k;
+    unsigned int packed;
+
+    for (i=0; i<n; i++) {
+        if (scores[i]) continue;
+        packed = _pack_move(&(moves[i]));
+        for (k=0; k<KILLERS_PER_PLY; k++) {
+            if (s->killers[ply][k] == packed) {
+                scores[i] = KILLER_SCORE - k;
+                break;
+            }
+        }
+    }
+}
+
+/* a quiet move causing a cutoff becomes the first killer of ply */
+void _update_killers(Search *s, Bitboard *b, int ply, Move *m)
+{
+    unsigned int packed = _pack_move(m);
+
+    if (m->promote_to != PIECE_NONE
+        || get_piece_type(b, m->to_file, m->to_rank) != PIECE_NONE
+        || s->killers[ply][0] == packed) {
+        return;
+    }
+    memmove(&(s->killers[ply][1]), &(s->killers[ply][0]),
+        (KILLERS_PER_PLY - 1) * sizeof(unsigned int));
+    s->killers[ply][0] = packed;
+}
+
+/*
+ * Returns the score of the position in b for the player of turn. A player
+ * without legal moves is checkmated if in check, and gets -INFINITY + ply so
+ * that shorter mates are preferred, stalemated (a draw, 0) otherwise. Nodes
+ * in check are searched one ply deeper.
+ *
+ * The principal variation from this node is left in s->pv[ply].
+ */
+float negaMax(Search *s, Bitboard *b, int depth, int ply, PieceColor turn, 
+    float alpha, float beta)
+{
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES];
+    int n_moves, n_staged, n_generated, i, tt_depth;
+    int generated = 0, n_searched = 0;
+    float tt_score;
+    TTBound tt_bound;
+    unsigned int tt_move = 0;
+    float alpha_orig = alpha;
+    float best_score = -INFINITY - 1;
+    Move *best_move = NULL;
+
+    s->pv_length[ply] = ply;
+
+    U64 key = bitboard_key(b, turn);
+    s->keys[ply] = key;
+    if (_is_draw(s, b, ply, turn)) return 0.0f;
+
+    // check extension: a check is never left to the quiescence search
+    int in_check = bitboard_is_in_check(b, turn);
+    if (in_check) depth++;
+
+    if (depth <= 0 || ply >= MAX_PLY - 1) {
+        return quiesce(s, b, ply, turn, alpha, beta);
+    }
+
+    if (_should_stop(s)) return 0.0f;
+    s->nodes++;
+    s->result.stats.nodes++;
+
+    s->result.stats.tt_probes++;
+    if (tt_probe(s->tt, key, &tt_depth, &tt_score, &tt_bound, &tt_move, ply)) {
+        s->result.stats.tt_hits++;
+        if (tt_depth >= depth) {
+            if (tt_bound == TT_EXACT) {
+                s->result.stats.tt_cutoffs++;
+                _pv_from_tt(s, b, turn, ply, tt_move, tt_depth);
+                return tt_score;
+            }
+            if ((tt_bound == TT_LOWER && tt_score >= beta)
+                || (tt_bound == TT_UPPER && tt_score <= alpha)) {
+                s->result.stats.tt_cutoffs++;
+                return tt_score;
+            }
+        }
+    }
+
+    // the hash move is tried before generating the moves
+    n_staged = n_moves = _stage_hash_move(b, turn, tt_move, moves);
+
+    PieceColor next_turn = _opposite(turn);
+
+    for (i=0; ; i++) {
+        if (i == n_moves) {
+            if (generated) break;
+            generated = 1;
+            s->result.stats.movegen_calls++;
+            n_generated = _generate_moves(b, turn, moves + n_staged, 0);
+            if (!n_generated) {
+                return in_check ? -INFINITY + ply : 0.0f;
+            }
+            n_moves = n_staged + _remove_staged(moves, n_staged, n_generated);
+            _score_moves(b, moves + n_staged, n_moves - n_staged, scores + n_staged);
+            _score_killers(s, ply, moves + n_staged, n_moves - n_staged, scores + n_staged);
+            if (i == n_moves) break;
+        }
+        if (i >= n_staged) _pick_move(moves, scores, i, n_moves);
+
+        Bitboard *b1 = clone_bitboard(b);
+        bitboard_do_move(b1, &(moves[i]));
+
+        // the hash move is only pseudo-legal: the king must be safe
+        if (i < n_staged && bitboard_is_in_check(b1, turn)) {
+            destroy_bitboard(b1);
+            continue;
+        }
+
+        // score the move with negaMax, but invert the resulting score
+        float score = -1 * negaMax(s, b1, depth - 1, ply + 1, next_turn, 
+            -beta, -alpha);
+
+        destroy_bitboard(b1);
+
+        if (s->stop) return 0.0f;
+
+        // even failing low, the best scoring move is a hint for later
+        if (score > best_score || !best_move) {
+            best_score = score;
+            best_move = &(moves[i]);
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            _update_pv(s, ply, &(moves[i]));
+        }
+
+        if (beta <= alpha) {
+            s->result.stats.cutoffs++;
+            if (!n_searched) s->result.stats.first_move_cutoffs++;
+            _update_killers(s, b, ply, &(moves[i]));
+            tt_store(s->tt, key, depth, alpha, TT_LOWER, best_move, ply);
+            return alpha;
+        }
+        n_searched++;
+    }
+
+    tt_store(s->tt, key, depth, alpha, 
+        (alpha > alpha_orig) ? TT_EXACT : TT_UPPER, best_move, ply);
+
     return alpha;
 }
 
-float get_best_move(Bitboard *b, Move *ptr_move_result, 
-    PieceColor turn, void (*callback_best_move_found)(Move *))
+/* sorts root moves by score, best first (insertion sort, keeps ties in order) */
+void _sort_root_moves(PVLine *root_moves, int n)
 {
+    int i, k;
+    PVLine tmp;
+    for (i=1; i<n; i++) {
+        memcpy(&tmp, &(root_moves[i]), sizeof(PVLine));
+        for (k=i; k > 0 && root_moves[k - 1].score < tmp.score; k--) {
+            memcpy(&(root_moves[k]), &(root_moves[k - 1]), sizeof(PVLine));
+        }
+        memcpy(&(root_moves[k]), &tmp, sizeof(PVLine));
+    }
+}
+
+/* the score the n-th best line must beat, among the moves searched so far */
+float _multipv_alpha(Search *s, int n_searched, int n_lines)
+{
+    float scores[MAX_MOVES];
+    int i, k;
+    float tmp;
+
+    if (n_searched < n_lines) return -INFINITY - 1;
+
+    for (i=0; i<n_searched; i++) {
+        scores[i] = s->root_moves[i].score;
+        for (k=i; k > 0 && scores[k - 1] < scores[k]; k--) {
+            tmp = scores[k];
+            scores[k] = scores[k - 1];
+            scores[k - 1] = tmp;
+        }
+    }
+    return scores[n_lines - 1];
+}
+
+/*
+ * One iteration at the root. With a single line, ties between the best moves
+ * are broken at random. With multipv, each move is searched with a window
+ * that makes its score exact if it ranks among the best lines found so far.
+ *
+ * Returns 0 if the search was stopped before the iteration completed.
+ */
+int _search_root(Search *s, int depth)
+{
+    Bitboard *b = s->board;
+    PieceColor next_turn = _opposite(s->turn);
+    int n_lines = s->options.multipv > 1 ? s->options.multipv : 1;
+    float max = -INFINITY - 1;
+    float alpha;
+    int i, best = 0;
     int should_assign_max;
-    Move move;
+    unsigned long long start_nodes = s->nodes;
+    long long start_ms = _now_ms();
 
-    /* iterate through all moves of the current color */
+    if (n_lines > s->n_root_moves) n_lines = s->n_root_moves;
 
-    // get piece positions
-    U64 piece_positions = (turn == PIECE_COLOR_WHITE) 
-        ?  bitboard_get_white_positions(b)
-        :  bitboard_get_black_positions(b);
+    for (i=0; i<s->n_root_moves; i++) {
+        PVLine *rm = &(s->root_moves[i]);
 
-    // the resulting maximum gain
-    float max = -INFINITY;
-    int n_legal_moves = 0;
+        // scores within TIE_MARGIN of max are exact, so ties can be seen
+        alpha = (n_lines > 1) 
+            ? _multipv_alpha(s, i, n_lines)
+            : max - TIE_MARGIN;
 
-    Move move_history[DEPTH];
+        Bitboard *b1 = clone_bitboard(b);
+        bitboard_do_move(b1, &(rm->move));
 
-    // we assume pieces are on the chessboard basically
-    while (piece_positions) {
-        init_move(&move);
-        piece_positions = get_next_cell_in(piece_positions, &move);
-        reset_legal_move_iterator(b);
-        while (get_next_legal_move(b, &move)) {
-            n_legal_moves++;
+        float score = -1 * negaMax(s, b1, depth - 1, 1, next_turn, 
+            -INFINITY - 1, -alpha);
 
-#ifndef NDEBUG
-            memcpy(&(move_history[0]), &move, sizeof(Move));
-#endif
+        destroy_bitboard(b1);
+
+        if (s->stop) return 0;
 
-            // move contains the next legal move for white
-            float score = negaMax(b, &move, DEPTH - 1, turn, -INFINITY-1, INFINITY+1, move_history);
+        // above alpha the score is exact and the line is kept, otherwise it
+        // is only an upper bound and the line is cut down to the move
+        rm->score = score;
+        if (score > alpha) {
+            rm->pv_length = s->pv_length[1];
+            memcpy(&(rm->pv[0]), &(rm->move), sizeof(Move));
+            memcpy(&(rm->pv[1]), &(s->pv[1][1]), (rm->pv_length - 1) * sizeof(Move));
+        }
+        else {
+            rm->pv_length = 1;
+            memcpy(&(rm->pv[0]), &(rm->move), sizeof(Move));
+        }
 
-            // if score is equal we decide randomly whether to assign best move
-            if (max == score) {
-                // check if odd/even
-                should_assign_max = (
-                    ((unsigned int) rand() << NBITS_IN_INT - 1
-                ) >> NBITS_IN_INT - 1) ;
+        if (n_lines > 1) continue;
 
-                // trigger max assignment
-                if (should_assign_max) {
-                    max = score - 1;
-                }
+        // if score is equal we decide randomly whether to assign best move
+        if (max == score) {
+            // check if odd/even
+            should_assign_max = (
+                ((unsigned int) rand_r(&(s->seed)) << NBITS_IN_INT - 1
+            ) >> NBITS_IN_INT - 1) ;
+
+            // trigger max assignment
+            if (should_assign_max) {
+                max = score - 1;
             }
+        }
 
-            // keep the best next legal move according to negamax
-            if (max < score) {
-                max = score;
+        // keep the best next legal move according to negamax
+        if (max < score) {
+            max = score;
+            best = i;
 
 #ifndef NDEBUG
-                print_move_fmt(&move, "Best: [%c%c -> %c%c]");
-                printf(" Score: %f\n", max);
+            print_move_fmt(&(rm->move), "Best: [%c%c -> %c%c]");
+            printf(" Score: %f\n", max);
 #endif
+        }
+    }
 
-                memcpy(ptr_move_result, &move, sizeof(Move));
+    // the best move is searched first in the next iteration
+    if (n_lines > 1) {
+        _sort_root_moves(s->root_moves, s->n_root_moves);
+    }
+    else if (best) {
+        PVLine tmp;
+        memcpy(&tmp, &(s->root_moves[best]), sizeof(PVLine));
+        memmove(&(s->root_moves[1]), &(s->root_moves[0]), best * sizeof(PVLine));
+        memcpy(&(s->root_moves[0]), &tmp, sizeof(PVLine));
+    }
 
-                if (callback_best_move_found != NULL) {
-                    callback_best_move_found(&move);
-                }
-            }
-        }
+    PVLine *rm = &(s->root_moves[0]);
+    memcpy(&(s->result.best_move), &(rm->move), sizeof(Move));
+    memcpy(s->result.pv, rm->pv, rm->pv_length * sizeof(Move));
+    s->result.pv_length = rm->pv_length;
+    s->result.score = rm->score;
+    s->result.depth = depth;
+
+    s->result.stats.depth = depth;
+    s->result.stats.depth_nodes[depth] = s->nodes - start_nodes;
+    s->result.stats.depth_time_ms[depth] = (long)(_now_ms() - start_ms);
+
+    if (s->lines) {
+        s->n_lines = n_lines;
+        memcpy(s->lines, s->root_moves, n_lines * sizeof(PVLine));
+    }
+
+    tt_store(s->tt, bitboard_key(b, s->turn), depth, rm->score, TT_EXACT, 
+        &(rm->move), 0);
+
+    if (s->options.callback_best_move_found != NULL) {
+        s->options.callback_best_move_found(&(rm->move));
+    }
+    if (s->options.callback_iteration != NULL) {
+        s->result.nodes = s->nodes;
+        s->result.time_ms = (long)(_now_ms() - s->start_ms);
+        s->options.callback_iteration(&(s->result));
+    }
+    return 1;
+}
+
+/*
+ * The expected reply comes from the principal variation, or else from the
+ * hash move of the position after the best move.
+ */
+void _set_ponder_move(Search *s)
+{
+    int tt_depth;
+    float tt_score;
+    TTBound tt_bound;
+    unsigned int tt_move;
+    Bitboard *b1;
+
+    if (s->result.pv_length > 1) {
+        memcpy(&(s->result.ponder_move), &(s->result.pv[1]), sizeof(Move));
+        s->result.has_ponder_move = 1;
+        return;
+    }
+
+    b1 = clone_bitboard(s->board);
+    bitboard_do_move(b1, &(s->result.best_move));
+    s->result.has_ponder_move = 0;
+    if (tt_probe(s->tt, bitboard_key(b1, _opposite(s->turn)), &tt_depth, 
+            &tt_score, &tt_bound, &tt_move, 1) && tt_move) {
+        _unpack_move(tt_move, &(s->result.ponder_move));
+        s->result.has_ponder_move = is_legal_move(b1, &(s->result.ponder_move));
+    }
+    destroy_bitboard(b1);
+}
+
+void *_search_thread(void *arg);
+Search *_create_search(Bitboard *b, PieceColor turn, SearchOptions *options, 
+    int ponder);
+void _destroy_search(Search *s);
+
+/*
+ * Helpers search the same position on their own thread, starting at
+ * different depths, and only share what they find through the table.
+ */
+void _start_helpers(Search *s)
+{
+    int i, n_helpers = s->options.threads - 1;
+
+    s->helpers = malloc(n_helpers * sizeof(Search *));
+    for (i=0; i<n_helpers; i++) {
+        Search *h = _create_search(s->board, s->turn, &(s->options), 0);
+        h->main = s;
+        h->tt = s->tt;
+        h->start_depth = 1 + (i + 1) % 2;
+        h->options.threads = 1;
+        h->options.multipv = 1;
+        h->options.infinite = 1;
+        h->options.depth = 0;
+        h->options.callback_best_move_found = NULL;
+        h->options.callback_iteration = NULL;
+        pthread_create(&(h->thread), NULL, _search_thread, h);
+        s->helpers[i] = h;
+    }
+}
+
+/* returns the nodes searched by the helpers */
+unsigned long long _stop_helpers(Search *s)
+{
+    int i, n_helpers = s->options.threads - 1;
+    unsigned long long nodes = 0;
+
+    s->stop = 1;
+    for (i=0; i<n_helpers; i++) {
+        pthread_join(s->helpers[i]->thread, NULL);
+        nodes += s->helpers[i]->nodes;
+        merge_search_stats(&(s->result.stats), &(s->helpers[i]->result.stats));
+        _destroy_search(s->helpers[i]);
+    }
+    free(s->helpers);
+    s->helpers = NULL;
+    return nodes;
+}
+
+void _run_search(Search *s)
+{
+    Move moves[MAX_MOVES];
+    int n_moves, depth, i;
+    int max_depth = s->options.depth ? s->options.depth : DEPTH;
+    BitboardPool *pool = NULL;
+
+    // boards cloned at each node come from a pool, unless one is attached
+    if (!bitboard_pool_attached()) {
+        pool = create_bitboard_pool(0);
+        bitboard_pool_attach(pool);
+    }
+
+    if (s->options.infinite || s->pondering) {
+        if (!s->options.depth) max_depth = MAX_PLY - 1;
     }
+    else if (s->options.movetime || s->options.nodes) {
+        if (!s->options.depth) max_depth = MAX_PLY - 1;
+    }
+
+    init_move(&(s->result.best_move));
+    init_move(&(s->result.ponder_move));
+    s->result.has_ponder_move = 0;
+    s->result.pv_length = 0;
+    s->result.score = -INFINITY;
+    s->result.depth = 0;
+    s->nodes = 0;
+    memset(&(s->result.stats), 0, sizeof(SearchStats));
+    s->keys[0] = bitboard_key(s->board, s->turn);
+    memset(s->killers, 0, sizeof(s->killers));
+
+    s->result.stats.movegen_calls++;
+    n_moves = _generate_moves(s->board, s->turn, moves, 0);
 
-    // declare checkmate
-    if (!n_legal_moves) {
-        PieceType king_piece = (turn == PIECE_COLOR_WHITE) ?
+    // declare checkmate, or stalemate (a draw)
+    if (!n_moves) {
+        PieceType king_piece = (s->turn == PIECE_COLOR_WHITE) ?
             WHITE_KING :
             BLACK_KING;
-        U64 king_square = b->position[king_piece];
+        U64 king_square = s->board->position[king_piece];
         int cell = _cell_of_bit(king_square);
-        ptr_move_result->from_rank = _RANK(cell);
-        ptr_move_result->to_rank = _RANK(cell);
-        ptr_move_result->from_file = _FILE(cell);
-        ptr_move_result->to_file = _FILE(cell);
-        ptr_move_result->is_checkmate = 1;
-        return -INFINITY;
+        s->result.best_move.from_rank = _RANK(cell);
+        s->result.best_move.to_rank = _RANK(cell);
+        s->result.best_move.from_file = _FILE(cell);
+        s->result.best_move.to_file = _FILE(cell);
+        if (bitboard_is_in_check(s->board, s->turn)) {
+            s->result.best_move.is_checkmate = 1;
+        }
+        else {
+            s->result.is_stalemate = 1;
+            s->result.score = 0.0f;
+        }
     }
+    else {
+        int scores[MAX_MOVES];
+        _score_moves(s->board, moves, n_moves, scores);
+
+        s->root_moves = malloc(n_moves * sizeof(PVLine));
+        s->n_root_moves = n_moves;
+        for (i=0; i<n_moves; i++) {
+            _pick_move(moves, scores, i, n_moves);
+            memcpy(&(s->root_moves[i].move), &(moves[i]), sizeof(Move));
+            memcpy(&(s->root_moves[i].pv[0]), &(moves[i]), sizeof(Move));
+            s->root_moves[i].pv_length = 1;
+            s->root_moves[i].score = -INFINITY - 1;
+        }
+
+        if (s->options.threads > 1 && !s->main) {
+            _start_helpers(s);
+        }
+
+        for (depth=s->start_depth; depth<=max_depth; depth++) {
+            if (!_search_root(s, depth)) {
+                break;
+            }
+            // a forced mate was found, no need to go deeper
+            if (IS_MATE_SCORE(s->result.score) || IS_MATE_SCORE(-s->result.score)) {
+                break;
+            }
+        }
+        // the first move is always available, even if stopped at depth 1
+        if (!s->result.depth) {
+            memcpy(&(s->result.best_move), &(moves[0]), sizeof(Move));
+        }
+        _set_ponder_move(s);
+    }
+
+    // a ponder or infinite search can only return once told so
+    while ((s->pondering || s->options.infinite) && !_should_stop(s)) {
+        usleep(1000);
+    }
+
+    s->result.nodes = s->nodes;
+    if (s->helpers) {
+        s->result.nodes += _stop_helpers(s);
+    }
+    s->result.time_ms = (long)(_now_ms() - s->start_ms);
+
+    if (pool) {
+        bitboard_pool_attach(NULL);
+        destroy_bitboard_pool(pool);
+    }
+}
+
+Search *_create_search(Bitboard *b, PieceColor turn, SearchOptions *options, 
+    int ponder)
+{
+    Search *s = malloc(sizeof(Search));
+    memset(s, 0, sizeof(Search));
+    s->board = clone_bitboard(b);
+    s->turn = turn;
+    if (options) {
+        memcpy(&(s->options), options, sizeof(SearchOptions));
+    }
+    else {
+        init_search_options(&(s->options));
+    }
+    s->tt = s->options.tt ? s->options.tt : _get_default_tt();
+    if (s->options.weights) {
+        memcpy(&(s->weights), s->options.weights, sizeof(EvalWeights));
+    }
+    else {
+        init_eval_weights(&(s->weights));
+    }
+    if (s->options.history_length > 0) {
+        s->history_length = s->options.history_length;
+        s->history = malloc(s->history_length * sizeof(U64));
+        memcpy(s->history, s->options.history, s->history_length * sizeof(U64));
+    }
+    s->options.history = s->history;
+    s->seed = s->options.seed ? s->options.seed : (unsigned int)rand();
+    s->pondering = ponder;
+    s->start_ms = _now_ms();
+    s->start_depth = 1;
+    return s;
+}
+
+void _destroy_search(Search *s)
+{
+    free(s->root_moves);
+    free(s->history);
+    destroy_bitboard(s->board);
+    free(s);
+}
+
+int engine_search_multipv(Bitboard *b, PieceColor turn, 
+    SearchOptions *options, int n_lines, PVLine *lines)
+{
+    Search *s;
+    int n;
+
+    if (n_lines < 1) return 0;
+
+    s = _create_search(b, turn, options, 0);
+    s->options.multipv = n_lines;
+    s->lines = lines;
+    _run_search(s);
 
-    return max;
+    n = s->n_lines;
+    _destroy_search(s);
+    return n;
+}
+
+void init_search_options(SearchOptions *options)
+{
+    memset(options, 0, sizeof(SearchOptions));
+}
+
+float engine_search(Bitboard *b, PieceColor turn, SearchOptions *options, 
+    SearchResult *result)
+{
+    Search *s = _create_search(b, turn, options, 0);
+    float score;
+
+    _run_search(s);
+
+    score = s->result.score;
+    if (result) {
+        memcpy(result, &(s->result), sizeof(SearchResult));
+    }
+    _destroy_search(s);
+    return score;
+}
+
+void *_search_thread(void *arg)
+{
+    _run_search((Search *)arg);
+    return NULL;
+}
+
+Search *engine_search_start(Bitboard *b, PieceColor turn, 
+    SearchOptions *options, int ponder)
+{
+    Search *s = _create_search(b, turn, options, ponder);
+    if (pthread_create(&(s->thread), NULL, _search_thread, s)) {
+        _destroy_search(s);
+        return NULL;
+    }
+    return s;
+}
+
+void engine_search_ponderhit(Search *s)
+{
+    // restart the clock before the time limits apply
+    s->start_ms = _now_ms();
+    __sync_synchronize();
+    s->pondering = 0;
+}
+
+void engine_search_stop(Search *s)
+{
+    s->stop = 1;
+}
+
+float engine_search_wait(Search *s, SearchResult *result)
+{
+    if (s->thread) {
+        pthread_join(s->thread, NULL);
+        s->thread = 0;
+    }
+
+    if (result) {
+        memcpy(result, &(s->result), sizeof(SearchResult));
+    }
+    return s->result.score;
+}
+
+void destroy_search(Search *s)
+{
+    if (s->thread) {
+        engine_search_stop(s);
+        engine_search_wait(s, NULL);
+    }
+    _destroy_search(s);
+}
+
+int engine_mate_in(float score)
+{
+    if (IS_MATE_SCORE(score)) return ((int)(INFINITY - score) + 1) / 2;
+    if (IS_MATE_SCORE(-score)) return -((int)(INFINITY + score) + 1) / 2;
+    return 0;
+}
+
+Search *engine_ponder_start(Bitboard *b, PieceColor turn, SearchResult *last, 
+    SearchOptions *options)
+{
+    Search *s;
+    Bitboard *b1;
+    SearchOptions ponder_options;
+    U64 *history;
+    int n = 0;
+
+    if (!last->has_ponder_move) return NULL;
+
+    if (options) {
+        memcpy(&ponder_options, options, sizeof(SearchOptions));
+    }
+    else {
+        init_search_options(&ponder_options);
+    }
+    if (ponder_options.history) n = ponder_options.history_length;
+    history = malloc((n + 1) * sizeof(U64));
+    if (n) memcpy(history, ponder_options.history, n * sizeof(U64));
+    history[n] = bitboard_key(b, _opposite(turn));
+    ponder_options.history = history;
+    ponder_options.history_length = n + 1;
+
+    b1 = clone_bitboard(b);
+    bitboard_do_move(b1, &(last->ponder_move));
+    s = engine_search_start(b1, turn, &ponder_options, 1);
+    destroy_bitboard(b1);
+    free(history);
+    return s;
+}
+
+float get_best_move(Bitboard *b, Move *ptr_move_result, 
+    PieceColor turn, void (*callback_best_move_found)(Move *))
+{
+    SearchOptions options;
+    SearchResult result;
+    float score;
+
+    init_search_options(&options);
+    options.callback_best_move_found = callback_best_move_found;
+
+    score = engine_search(b, turn, &options, &result);
+    memcpy(ptr_move_result, &(result.best_move), sizeof(Move));
+
+    return score;
 }
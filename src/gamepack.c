@@ -0,0 +1,207 @@
+#include "gamepack.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INDEX_INITIAL_SIZE 1024
+
+/* - - - - - - - - MOVES - - - - - - - - */
+
+uint16_t game_pack_encode_move(Move *m)
+{
+    uint16_t promote;
+
+    switch (m->promote_to) {
+        case WHITE_QUEEN: case BLACK_QUEEN: promote = GAME_PACK_PROMOTE_QUEEN; break;
+        case WHITE_ROOK: case BLACK_ROOK: promote = GAME_PACK_PROMOTE_ROOK; break;
+        case WHITE_BISHOP: case BLACK_BISHOP: promote = GAME_PACK_PROMOTE_BISHOP; break;
+        case WHITE_KNIGHT: case BLACK_KNIGHT: promote = GAME_PACK_PROMOTE_KNIGHT; break;
+        default: promote = GAME_PACK_PROMOTE_NONE;
+    }
+
+    return (uint16_t)((m->from_rank * 8 + m->from_file)
+        | ((m->to_rank * 8 + m->to_file) << 6)
+        | (promote << 12));
+}
+
+void game_pack_decode_move(uint16_t code, int is_white, Move *m)
+{
+    int from = code & 0x3F;
+    int to = (code >> 6) & 0x3F;
+
+    m->from_file = from % 8;
+    m->from_rank = from / 8;
+    m->to_file = to % 8;
+    m->to_rank = to / 8;
+
+    switch (code >> 12) {
+        case GAME_PACK_PROMOTE_QUEEN: m->promote_to = is_white ? WHITE_QUEEN : BLACK_QUEEN; break;
+        case GAME_PACK_PROMOTE_ROOK: m->promote_to = is_white ? WHITE_ROOK : BLACK_ROOK; break;
+        case GAME_PACK_PROMOTE_BISHOP: m->promote_to = is_white ? WHITE_BISHOP : BLACK_BISHOP; break;
+        case GAME_PACK_PROMOTE_KNIGHT: m->promote_to = is_white ? WHITE_KNIGHT : BLACK_KNIGHT; break;
+        default: m->promote_to = PIECE_NONE;
+    }
+}
+
+/* - - - - - - - - WRITER - - - - - - - - */
+
+struct game_pack_writer_t {
+    FILE *f;
+    uint64_t offset;
+    int failed;
+
+    uint64_t *index;
+    uint64_t n_games;
+    uint64_t index_size;
+};
+
+GamePackWriter *create_game_pack_writer(FILE *f)
+{
+    GamePackWriter *w = malloc(sizeof(GamePackWriter));
+    GamePackHeader header;
+
+    memset(w, 0, sizeof(GamePackWriter));
+    w->f = f;
+    w->index_size = INDEX_INITIAL_SIZE;
+    w->index = malloc(w->index_size * sizeof(uint64_t));
+
+    /* written again once the index is known */
+    memset(&header, 0, sizeof(GamePackHeader));
+    if (fwrite(&header, sizeof(GamePackHeader), 1, f) != 1) w->failed = 1;
+    w->offset = sizeof(GamePackHeader);
+    return w;
+}
+
+int game_pack_write_game(GamePackWriter *w, GameInfo *info,
+    uint16_t *moves, unsigned int n_moves)
+{
+    PackedGame game;
+    uint16_t padding = 0;
+
+    memset(&game, 0, sizeof(PackedGame));
+    game.n_moves = n_moves;
+    game.white_elo = info->white_elo;
+    game.black_elo = info->black_elo;
+    game.result = info->result;
+    memcpy(game.eco, info->eco, strnlen(info->eco, sizeof(game.eco)));
+
+    if (w->n_games == w->index_size) {
+        w->index_size *= 2;
+        w->index = realloc(w->index, w->index_size * sizeof(uint64_t));
+    }
+    w->index[w->n_games++] = w->offset;
+
+    if (fwrite(&game, sizeof(PackedGame), 1, w->f) != 1
+        || fwrite(moves, sizeof(uint16_t), n_moves, w->f) != n_moves) {
+        w->failed = 1;
+    }
+    w->offset += sizeof(PackedGame) + n_moves * sizeof(uint16_t);
+
+    /* the next game is 4-byte aligned */
+    if (n_moves & 1) {
+        if (fwrite(&padding, sizeof(uint16_t), 1, w->f) != 1) w->failed = 1;
+        w->offset += sizeof(uint16_t);
+    }
+    return !w->failed;
+}
+
+int close_game_pack_writer(GamePackWriter *w)
+{
+    GamePackHeader header;
+    int ok;
+
+    /* the index is 8-byte aligned in the file */
+    while (w->offset % sizeof(uint64_t)) {
+        if (fputc(0, w->f) == EOF) w->failed = 1;
+        w->offset++;
+    }
+
+    memcpy(header.magic, GAME_PACK_MAGIC, 4);
+    header.version = GAME_PACK_VERSION;
+    header.n_games = w->n_games;
+    header.index_offset = w->offset;
+
+    if (fwrite(w->index, sizeof(uint64_t), w->n_games, w->f) != w->n_games
+        || fseek(w->f, 0, SEEK_SET) < 0
+        || fwrite(&header, sizeof(GamePackHeader), 1, w->f) != 1
+        || fflush(w->f) == EOF) {
+        w->failed = 1;
+    }
+
+    ok = !w->failed;
+    free(w->index);
+    free(w);
+    return ok;
+}
+
+/* - - - - - - - - READER - - - - - - - - */
+
+struct game_pack_t {
+    const char *data;
+    size_t size;
+    const GamePackHeader *header;
+    const uint64_t *index;
+};
+
+GamePack *open_game_pack(int fd)
+{
+    GamePack *p;
+    const GamePackHeader *header;
+    struct stat st;
+    void *data;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(GamePackHeader)) {
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return NULL;
+
+    header = (const GamePackHeader *)data;
+    if (memcmp(header->magic, GAME_PACK_MAGIC, 4)
+        || header->version != GAME_PACK_VERSION
+        || header->index_offset > (uint64_t)st.st_size
+        || header->n_games > (st.st_size - header->index_offset) / sizeof(uint64_t)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    p = malloc(sizeof(GamePack));
+    p->data = data;
+    p->size = st.st_size;
+    p->header = header;
+    p->index = (const uint64_t *)(p->data + header->index_offset);
+    return p;
+}
+
+void close_game_pack(GamePack *p)
+{
+    munmap((void *)p->data, p->size);
+    free(p);
+}
+
+unsigned long long game_pack_count(GamePack *p)
+{
+    return p->header->n_games;
+}
+
+const PackedGame *game_pack_get(GamePack *p, unsigned long long n)
+{
+    uint64_t offset, end = p->header->index_offset;
+    const PackedGame *game;
+
+    if (n >= p->header->n_games) return NULL;
+
+    /* the game and its moves must lie between the header and the index */
+    offset = p->index[n];
+    if (offset < sizeof(GamePackHeader) || offset > end
+        || end - offset < sizeof(PackedGame)) {
+        return NULL;
+    }
+    game = (const PackedGame *)(p->data + offset);
+    if ((end - offset - sizeof(PackedGame)) / sizeof(uint16_t) < game->n_moves) {
+        return NULL;
+    }
+    return game;
+}
@@ -0,0 +1,323 @@
+#include "gamereader.h"
+#include "gamepack.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READ_BLOCK_SIZE (1 << 20)
+
+#define IS_FILE(ch) ((ch) >= 'a' && (ch) <= 'h')
+#define IS_RANK(ch) ((ch) >= '1' && (ch) <= '8')
+#define IS_SPACE(ch) ((ch) == ' ' || (ch) == '\n' || (ch) == '\r' || (ch) == '\t')
+
+typedef enum {
+    READER_BETWEEN_GAMES,
+    READER_IN_GAME,
+    READER_SKIPPING_GAME    /* after an illegal move, up to the result */
+} ReaderState;
+
+struct game_reader_t {
+    GameReaderCallbacks callbacks;
+    ReaderState state;
+    GameInfo info;
+
+    /* every game starts as a copy of the initial board */
+    Bitboard *initial_chessboard;
+    Bitboard *chessboard;
+};
+
+GameReader *create_game_reader(GameReaderCallbacks *callbacks)
+{
+    GameReader *r = malloc(sizeof(GameReader));
+
+    memset(r, 0, sizeof(GameReader));
+    if (callbacks) {
+        memcpy(&(r->callbacks), callbacks, sizeof(GameReaderCallbacks));
+    }
+    r->state = READER_BETWEEN_GAMES;
+    r->initial_chessboard = bitboard_from_fen(FEN_INITIAL_POSITION);
+    r->chessboard = create_blank_bitboard();
+    return r;
+}
+
+void destroy_game_reader(GameReader *r)
+{
+    destroy_bitboard(r->initial_chessboard);
+    destroy_bitboard(r->chessboard);
+    free(r);
+}
+
+/* - - - - - - - - EVENTS - - - - - - - - */
+
+void _reader_new_game(GameReader *r)
+{
+    r->state = READER_IN_GAME;
+    r->info.n_moves = 0;
+    r->info.illegal = 0;
+    memcpy(r->chessboard, r->initial_chessboard, sizeof(Bitboard));
+    if (r->callbacks.on_game_start) {
+        r->callbacks.on_game_start(&(r->info), r->callbacks.user_data);
+    }
+}
+
+void _reader_end_game(GameReader *r)
+{
+    if (r->state != READER_BETWEEN_GAMES && r->callbacks.on_game_end) {
+        r->callbacks.on_game_end(&(r->info), r->callbacks.user_data);
+    }
+    if (r->state != READER_BETWEEN_GAMES) {
+        r->info.index++;
+    }
+    r->state = READER_BETWEEN_GAMES;
+
+    /* tags of the next game */
+    r->info.result = GAME_RESULT_UNKNOWN;
+    r->info.white_elo = 0;
+    r->info.black_elo = 0;
+    r->info.eco[0] = '\0';
+}
+
+/* returns 0 if reading must stop */
+int _reader_do_move(GameReader *r, Move *m)
+{
+    if (is_legal_move(r->chessboard, m)) {
+        bitboard_do_move(r->chessboard, m);
+        r->info.n_moves++;
+        if (r->callbacks.on_move) {
+            return r->callbacks.on_move(&(r->info), r->chessboard, m,
+                r->callbacks.user_data);
+        }
+        return 1;
+    }
+
+    r->info.illegal = 1;
+    r->state = READER_SKIPPING_GAME;
+    if (r->callbacks.on_illegal_move) {
+        return r->callbacks.on_illegal_move(&(r->info), r->chessboard, m,
+            r->callbacks.user_data);
+    }
+    return 0;
+}
+
+/* - - - - - - - - PARSER & HELPERS - - - - - - - - */
+
+PieceType _reader_promote_piece(char ch, int is_white)
+{
+    switch (ch) {
+        case 'Q': return is_white ? WHITE_QUEEN : BLACK_QUEEN;
+        case 'R': return is_white ? WHITE_ROOK : BLACK_ROOK;
+        case 'N': return is_white ? WHITE_KNIGHT : BLACK_KNIGHT;
+        case 'B': return is_white ? WHITE_BISHOP : BLACK_BISHOP;
+    }
+    return PIECE_NONE;
+}
+
+GameResult _reader_parse_result(const char *p, const char *end)
+{
+    if (end - p >= 3 && !memcmp(p, "1-0", 3)) return GAME_RESULT_WHITE_WINS;
+    if (end - p >= 3 && !memcmp(p, "0-1", 3)) return GAME_RESULT_BLACK_WINS;
+    if (end - p >= 7 && !memcmp(p, "1/2-1/2", 7)) return GAME_RESULT_DRAW;
+    return GAME_RESULT_UNKNOWN;
+}
+
+/* the tags of interest, p is right after the '[' */
+void _reader_parse_tag(GameReader *r, const char *p, const char *end)
+{
+    const char *value = memchr(p, '"', end - p);
+    if (!value) return;
+    value++;
+
+    if (!memcmp(p, "Result ", 7)) {
+        r->info.result = _reader_parse_result(value, end);
+    }
+    else if (!memcmp(p, "WhiteElo ", 9)) {
+        r->info.white_elo = atoi(value);
+    }
+    else if (!memcmp(p, "BlackElo ", 9)) {
+        r->info.black_elo = atoi(value);
+    }
+    else if (!memcmp(p, "ECO ", 4)) {
+        int i;
+        for (i=0; i<3 && value + i < end && value[i] != '"'; i++) {
+            r->info.eco[i] = value[i];
+        }
+        r->info.eco[i] = '\0';
+    }
+}
+
+/*
+ * Tokens of the move text are told apart by their first char:
+ *
+ *  - "e2-e4", "e7-e8Q+": a move, decoded in place
+ *  - "12.": a move number
+ *  - "1-0", "0-1", "1/2-1/2", "*": the result, which ends the game
+ */
+int game_reader_parse(GameReader *r, const char *data, size_t size)
+{
+    const char *p = data;
+    const char *end = data + size;
+    const char *eol;
+    Move move = {0};
+
+    while (p < end) {
+        char ch = *p;
+
+        if (IS_SPACE(ch)) {
+            p++;
+        }
+        else if (ch == '[') {
+            /* a tag line, a game without result ends here */
+            if (r->state != READER_BETWEEN_GAMES) _reader_end_game(r);
+
+            eol = memchr(p, '\n', end - p);
+            if (!eol) eol = end;
+            if (eol - p > 9) _reader_parse_tag(r, p + 1, eol);
+            p = eol;
+        }
+        else if (IS_FILE(ch) && p + 5 <= end && IS_RANK(p[1]) && p[2] == '-'
+                 && IS_FILE(p[3]) && IS_RANK(p[4])) {
+            if (r->state == READER_BETWEEN_GAMES) _reader_new_game(r);
+
+            if (r->state == READER_IN_GAME) {
+                move.from_file = p[0] - 97;
+                move.from_rank = p[1] - 49;
+                move.to_file = p[3] - 97;
+                move.to_rank = p[4] - 49;
+                move.promote_to = (p + 5 < end)
+                    ? _reader_promote_piece(p[5], !(r->info.n_moves & 1))
+                    : PIECE_NONE;
+
+                if (!_reader_do_move(r, &move)) return 0;
+            }
+
+            /* skip check/mate markers and the promotion piece */
+            p += 5;
+            while (p < end && !IS_SPACE(*p)) p++;
+        }
+        else if (ch == '*' || (p + 1 < end && (p[1] == '-' || p[1] == '/'))) {
+            /* HALT CONDITION */
+            if (r->state != READER_BETWEEN_GAMES) {
+                GameResult result = _reader_parse_result(p, end);
+                if (result != GAME_RESULT_UNKNOWN) r->info.result = result;
+                _reader_end_game(r);
+            }
+            while (p < end && !IS_SPACE(*p)) p++;
+        }
+        else {
+            /* move numbers, or anything unexpected */
+            while (p < end && !IS_SPACE(*p)) p++;
+        }
+    }
+    return 1;
+}
+
+void game_reader_finish(GameReader *r)
+{
+    _reader_end_game(r);
+}
+
+int game_reader_parse_fd(GameReader *r, int fd)
+{
+    struct stat st;
+    const char *data;
+    char *buffer;
+    size_t used = 0, capacity = READ_BLOCK_SIZE;
+    ssize_t n_read;
+    int result = 1;
+
+    if (fstat(fd, &st) < 0) return -1;
+
+    if (S_ISREG(st.st_mode)) {
+        if (!st.st_size) return 1;
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+            result = game_reader_parse(r, data, st.st_size);
+            munmap((void *)data, st.st_size);
+            return result;
+        }
+    }
+
+    /* blocks are parsed up to their last line, the rest is kept */
+    buffer = malloc(capacity);
+    while (result == 1 && (n_read = read(fd, buffer + used, capacity - used)) > 0) {
+        size_t complete = used + n_read;
+        used += n_read;
+
+        /* memrchr is not portable */
+        while (complete && buffer[complete - 1] != '\n') complete--;
+        if (!complete) {
+            if (used == capacity) {
+                capacity *= 2;
+                buffer = realloc(buffer, capacity);
+            }
+            continue;
+        }
+
+        result = game_reader_parse(r, buffer, complete);
+        used -= complete;
+        memmove(buffer, buffer + complete, used);
+    }
+    if (n_read < 0) result = -1;
+    if (result == 1 && used) {
+        result = game_reader_parse(r, buffer, used);
+    }
+    free(buffer);
+    return result;
+}
+
+/* - - - - - - - - PACKED GAMES - - - - - - - - */
+
+int game_reader_replay_pack(GameReader *r, GamePack *p,
+    unsigned long long first, unsigned long long count)
+{
+    unsigned long long n;
+    unsigned int i;
+    Move move;
+
+    for (n=first; n < first + count && n < game_pack_count(p); n++) {
+        const PackedGame *game = game_pack_get(p, n);
+        const uint16_t *moves;
+        PieceType t;
+
+        if (!game) continue;
+        moves = (const uint16_t *)(game + 1);
+
+        if (r->state != READER_BETWEEN_GAMES) _reader_end_game(r);
+        r->info.index = n;
+        r->info.result = game->result;
+        r->info.white_elo = game->white_elo;
+        r->info.black_elo = game->black_elo;
+        memcpy(r->info.eco, game->eco, sizeof(game->eco));
+        r->info.eco[sizeof(game->eco)] = '\0';
+        _reader_new_game(r);
+
+        /*
+         * packed games are legal, moves go straight to the board once they
+         * are known to move a piece of the side to move
+         */
+        for (i=0; i<game->n_moves; i++) {
+            game_pack_decode_move(moves[i], !(i & 1), &move);
+            t = get_piece_type(r->chessboard, move.from_file, move.from_rank);
+            if (t >= PIECE_TYPE_COUNT || (t < BLACK_PAWN) != !(i & 1)) {
+                r->info.illegal = 1;
+                if (!r->callbacks.on_illegal_move || !r->callbacks.on_illegal_move(
+                        &(r->info), r->chessboard, &move, r->callbacks.user_data)) {
+                    return 0;
+                }
+                break;
+            }
+            bitboard_do_move(r->chessboard, &move);
+            r->info.n_moves++;
+            if (r->callbacks.on_move && !r->callbacks.on_move(&(r->info),
+                    r->chessboard, &move, r->callbacks.user_data)) {
+                return 0;
+            }
+        }
+        _reader_end_game(r);
+    }
+    return 1;
+}
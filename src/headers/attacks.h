@@ -0,0 +1,53 @@
+#ifndef ATTACKS_h
+#define ATTACKS_h
+
+#include "bitboard.h"
+
+/*
+ * Set-wise attacks: all the cells attacked by a set of pieces at once, with
+ * the same fixed number of branchless operations whatever the number of
+ * pieces. Sliding pieces use Kogge-Stone occluded fills: empty is the set of
+ * empty cells, the first occupied cell of each ray is attacked and stops it.
+ *
+ * When compiled with AVX2 (make AVX2=1), the 8 ray directions are filled 4 at
+ * a time in 256-bit registers, otherwise one at a time.
+ */
+
+U64 get_rook_attacks_setwise(U64 rooks, U64 empty);
+U64 get_bishop_attacks_setwise(U64 bishops, U64 empty);
+U64 get_queen_attacks_setwise(U64 queens, U64 empty);
+U64 get_knight_attacks_setwise(U64 knights);
+U64 get_king_attacks_setwise(U64 kings);            /* without castling */
+U64 get_pawn_attacks_setwise(U64 pawns, PieceColor color);
+
+/* rook-like moves of orth and bishop-like moves of diag, in one pass */
+U64 get_slider_attacks_setwise(U64 orth, U64 diag, U64 empty);
+
+/* every cell attacked (or defended) by the pieces of color */
+U64 bitboard_get_attacks_by(Bitboard *b, PieceColor color);
+
+/*
+ * Attack maps cached in the position, so that the callers needing them
+ * during move generation and evaluation share one computation. They are
+ * computed on first demand and dropped by bitboard_do_move; code changing
+ * b->position by hand must call bitboard_invalidate_attacks.
+ *
+ * - bitboard_get_attack_map: as bitboard_get_attacks_by, the union of the
+ *   sets of the 6 piece types of color, which are cached along with it.
+ * - bitboard_get_piece_attacks: the cells attacked by the pieces of type t
+ *   (t < PIECE_TYPE_COUNT).
+ * - bitboard_get_king_danger: the cells the king of color can't move to,
+ *   i.e. attacked by the opponent once the king has left its cell.
+ */
+U64 bitboard_get_attack_map(Bitboard *b, PieceColor color);
+U64 bitboard_get_piece_attacks(Bitboard *b, PieceType t);
+U64 bitboard_get_king_danger(Bitboard *b, PieceColor color);
+void bitboard_invalidate_attacks(Bitboard *b);
+
+/*
+ * The pieces, of both colors, attacking at least one of cells. Same as the
+ * union of get_attacks_to_square over cells, in one pass.
+ */
+U64 bitboard_get_attackers_to(Bitboard *b, U64 cells);
+
+#endif
@@ -56,6 +56,11 @@ typedef enum piece_type_t {
     PIECE_NONE  
 } PieceType;
 
+typedef enum piece_color_t {
+    PIECE_COLOR_WHITE,
+    PIECE_COLOR_BLACK
+} PieceColor;
+
 typedef struct {
     FileType from_file;
     RankType from_rank;
@@ -85,6 +90,26 @@ typedef struct {
     /* used to compute the next legal move */
     U64 legal_move_iterator;
     U64 legal_move_iterator_lastcell;
+
+    /* zobrist key of pieces, castling and en-passant rights */
+    U64 hash;
+
+    /*
+     * Cells attacked by each color, and cells the king of each color can't
+     * step on, indexed by PieceColor. Computed on first demand and dropped by
+     * bitboard_do_move, a bit per map in attack_maps_valid (see attacks.h).
+     * piece_attacks holds the cells attacked by each piece type, valid along
+     * with the attack map of its color.
+     */
+    U64 piece_attacks[PIECE_TYPE_COUNT];
+    U64 attack_maps[2];
+    U64 king_danger_maps[2];
+    unsigned int attack_maps_valid;
+
+    /* side to move and move counters, as in FEN */
+    PieceColor turn;
+    unsigned int halfmove_clock;
+    unsigned int fullmove_number;
 } Bitboard;
 
 Bitboard *create_bitboard(void *chessboard_base, unsigned int chessboard_element_size, PieceType (*func_type_mapper)(void *), int reverse_ranks);
@@ -93,11 +118,83 @@ Bitboard *clone_bitboard(Bitboard *b);
 Bitboard *create_blank_bitboard();
 void destroy_bitboard(Bitboard *bitboard);
 
+/*
+ * Pools of bitboards, for threads creating and destroying many of them.
+ *
+ * While a pool is attached to a thread, create_blank_bitboard, clone_bitboard
+ * and the other constructors called on that thread take boards from it, and
+ * destroy_bitboard gives them back to the pool they came from. Boards are
+ * carved from 64-byte aligned slabs of boards_per_slab boards (0 means a
+ * default size), and reused through a free list.
+ *
+ * - bitboard_pool_attach: attaches p to the calling thread, NULL detaches.
+ * - bitboard_pool_reset: gives back all boards of p at once, in O(1). Boards
+ *   taken from p must not be used (or destroyed) afterwards.
+ * - destroy_bitboard_pool: frees the slabs, p must not be attached.
+ *
+ * A pool is not thread safe: its boards must only be created and destroyed
+ * by the thread it is attached to.
+ */
+typedef struct bitboard_pool_t BitboardPool;
+
+typedef struct {
+    unsigned long long allocations;
+    unsigned long long frees;
+    unsigned long long resets;
+    unsigned long long slabs;
+    unsigned long long in_use;
+    unsigned long long peak_in_use;
+} BitboardPoolStats;
+
+BitboardPool *create_bitboard_pool(unsigned int boards_per_slab);
+void destroy_bitboard_pool(BitboardPool *p);
+void bitboard_pool_attach(BitboardPool *p);
+BitboardPool *bitboard_pool_attached();
+void bitboard_pool_reset(BitboardPool *p);
+void bitboard_pool_stats(BitboardPool *p, BitboardPoolStats *stats);
+
+/*
+ * Forsyth-Edwards Notation. Pieces, side to move, castling and en-passant
+ * rights are taken exactly from the FEN (castling rights only if the king and
+ * the rook are in place), the move counters are optional.
+ *
+ * - bitboard_from_fen: returns NULL if fen is malformed.
+ * - bitboard_set_fen: reuses b, returns 0 if fen is malformed (b is then not
+ *   a valid position).
+ * - bitboard_to_fen: dest must have room for FEN_MAX_LENGTH chars.
+ */
+#define FEN_MAX_LENGTH 92
+#define FEN_INITIAL_POSITION "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+Bitboard *bitboard_from_fen(const char *fen);
+int bitboard_set_fen(Bitboard *b, const char *fen);
+void bitboard_to_fen(Bitboard *b, char *dest);
+
 void init_move(Move *m);
+int is_same_move(Move *a, Move *b);
 
 /* I may cache these for efficiency */
 int is_legal_move(Bitboard *b, Move *m);
+
+/*
+ * Whether the piece on the from cell of m can make m, as far as the pieces
+ * of both sides allow, but without looking at the safety of its own king:
+ * a few mask operations, to check a move found in the hash table or a killer
+ * move before trying it. The caller checks the piece belongs to the side to
+ * move, then that its king is not in check once m is made. Castling is
+ * fully checked (with is_legal_move).
+ */
+int bitboard_is_pseudo_legal(Bitboard *b, Move *m);
 void bitboard_do_move(Bitboard *b, Move *m);
+
+/*
+ * Whether the king of color is attacked, from the cached attack maps, and
+ * whether color has any legal move, stopping at the first piece having one.
+ * Together they tell checkmate from stalemate.
+ */
+int bitboard_is_in_check(Bitboard *b, PieceColor color);
+int bitboard_has_legal_move(Bitboard *b, PieceColor color);
+
 U64 bitboard_get_white_positions(Bitboard *b);
 U64 bitboard_get_black_positions(Bitboard *b);
 int bitboard_get_white_count(Bitboard *b);
@@ -108,6 +205,31 @@ U64 bitboard_get_all_positions(Bitboard *b);
 
 char *bitboard_piece_name(PieceType t);
 
+/*
+ * Zobrist hashing. The key stored in Bitboard.hash is kept up to date by
+ * bitboard_do_move. bitboard_key also mixes in the side to move, and should
+ * be used whenever two positions must be told apart (e.g., transpositions).
+ */
+U64 bitboard_compute_hash(Bitboard *b);
+U64 bitboard_key(Bitboard *b, PieceColor turn);
+
+/*
+ * Coordinate notation, as in "e2e4" or "e7e8q". dest must have room for 6
+ * chars. move_from_string checks the syntax, and that a piece of b->turn is
+ * on the from cell, returns 0 if not. Use is_legal_move for the rest.
+ */
+void move_to_string(Move *m, char *dest);
+int move_from_string(Bitboard *b, const char *str, Move *m);
+
+/*
+ * Standard algebraic notation, as in "Nbd7", "exd5", "e8=Q" or "O-O", without
+ * check marks. m must be legal on b, dest must have room for 8 chars.
+ * move_from_san finds the legal move of b->turn matching san (check marks,
+ * annotations and '=' are ignored), returns 0 if there is none.
+ */
+void move_to_san(Bitboard *b, Move *m, char *dest);
+int move_from_san(Bitboard *b, const char *san, Move *m);
+
 void print_move(Move *m);
 void print_move_fmt(Move *m, const char *fmt);
 void print_bitboard(Bitboard *b);
@@ -115,6 +237,22 @@ void print_chessboard(Bitboard *b);
 void print_chessboard_move(Bitboard *b, Move *m);
 void print_bits(U64 b);
 U64 get_attacks_to_square(Bitboard *b, FileType file, RankType rank);
+
+/*
+ * Squares attacked by the piece at file, rank (piece_pos is its bit). Kings
+ * include their castling targets, pawns their moves unless attacks_only.
+ */
+U64 get_rook_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_bishop_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_queen_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_knight_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_white_king_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_black_king_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos);
+U64 get_white_pawn_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos,
+    int attacks_only);
+U64 get_black_pawn_attacks(Bitboard *b, FileType file, RankType rank, U64 piece_pos,
+    int attacks_only);
+
 U64 bitboard_get_center_attackers(Bitboard *b);
 U64 get_legal_moves(Bitboard *b, FileType file, RankType rank);
 void reset_legal_move_iterator(Bitboard *b);
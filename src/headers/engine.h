@@ -2,20 +2,204 @@
 #define ENGINE_h
 
 #define ENGINE_MAX_MEMORY 2147483648
+#define ENGINE_DEFAULT_HASH_MB 16
+#define ENGINE_MAX_PLY 64
 #define SCORE_INFINITE 99999999
 #define MIN(x,y) ((x < y) ? x : y)
 
 #include "bitboard.h"
 
-typedef enum piece_color_t {
-    PIECE_COLOR_WHITE,
-    PIECE_COLOR_BLACK
-} PieceColor;
+/*
+ * Transposition table, shared by searches that use the same instance. The
+ * engine keeps a default one, used when SearchOptions.tt is NULL.
+ */
+typedef struct transposition_table_t TranspositionTable;
 
-/* turn: 0 = black, 1 = white */
-float get_best_move(Bitboard *b, Move *ptr_move_result, 
+TranspositionTable *create_transposition_table(unsigned int size_mb);
+void clear_transposition_table(TranspositionTable *tt);
+void destroy_transposition_table(TranspositionTable *tt);
+
+/* resize or clear the engine default table, only while no search runs */
+void engine_set_hash_size(unsigned int size_mb);
+void engine_clear_hash();
+
+/*
+ * Weights of the terms of evaluate_bitboard. A term with weight 0 is not
+ * computed.
+ *
+ * - center_attackers: per center cell attacked, once per piece type
+ *   attacking it.
+ * - mobility_*: per cell not occupied by own pieces attacked by the pieces of
+ *   that type (cells attacked by two pieces of a type count once).
+ * - king_zone_attacks: per cell around (or of) the opponent king attacked.
+ */
+typedef struct {
+    float material;
+    float piece_count;
+    float center_occupation;
+    float center_attackers;
+    float mobility_knight;
+    float mobility_bishop;
+    float mobility_rook;
+    float mobility_queen;
+    float king_zone_attacks;
+} EvalWeights;
+
+void init_eval_weights(EvalWeights *w);
+float evaluate_bitboard(Bitboard *b, PieceColor turn);
+float evaluate_bitboard_weights(Bitboard *b, PieceColor turn, EvalWeights *w);
+
+/*
+ * Static exchange evaluation: the material won by m (a pawn is 100) once the
+ * captures on its target cell have been played, least valuable attacker
+ * first, each side stopping when going on would lose. Sliders behind a piece
+ * that has captured join in (x-rays). 0 for a quiet move.
+ */
+int bitboard_see(Bitboard *b, Move *m);
+
+/* a root move, its score and the principal variation starting with it */
+typedef struct {
+    Move move;
+    float score;
+    int pv_length;
+    Move pv[ENGINE_MAX_PLY];
+} PVLine;
+
+/*
+ * Counters of a search. Each thread counts on its own, the counters of the
+ * helper threads are added to the main search at the end. Per-depth values
+ * are those of the main search only, indexed by depth.
+ */
+typedef struct {
+    unsigned long long nodes;               /* main search nodes */
+    unsigned long long qnodes;              /* quiescence nodes */
+    unsigned long long cutoffs;             /* beta cutoffs in the main search */
+    unsigned long long first_move_cutoffs;  /* of which on the first move */
+    unsigned long long tt_probes;           /* transposition table lookups */
+    unsigned long long tt_hits;             /* of which found the position */
+    unsigned long long tt_cutoffs;          /* of which ended the node */
+    unsigned long long movegen_calls;
+    unsigned long long eval_calls;
+    int depth;                              /* last completed iteration */
+    unsigned long long depth_nodes[ENGINE_MAX_PLY];  /* nodes of each iteration */
+    long depth_time_ms[ENGINE_MAX_PLY];     /* time of each iteration */
+} SearchStats;
+
+/* share of the beta cutoffs that happened on the first move, 0 to 1 */
+float search_stats_first_move_cutoff_rate(SearchStats *stats);
+
+/*
+ * Effective branching factor: ratio of the nodes of the last two completed
+ * iterations. 0 before the second iteration.
+ */
+float search_stats_branching_factor(SearchStats *stats);
+
+/* adds the counters of src to dest (not the per-depth values) */
+void merge_search_stats(SearchStats *dest, SearchStats *src);
+
+typedef struct {
+    Move best_move;             /* its is_checkmate is set if mated */
+    int is_stalemate;           /* no legal move and not in check */
+    Move ponder_move;           /* expected reply, if has_ponder_move */
+    int has_ponder_move;
+    Move pv[ENGINE_MAX_PLY];    /* principal variation, from best_move */
+    int pv_length;
+    float score;
+    int depth;                  /* last completed iteration */
+    unsigned long long nodes;
+    long time_ms;
+    SearchStats stats;
+} SearchResult;
+
+typedef struct {
+    int depth;                  /* maximum depth, 0 means the default depth */
+    long movetime;              /* milliseconds, 0 means no time limit */
+    unsigned long long nodes;   /* 0 means no node limit */
+    int infinite;               /* only stop on engine_search_stop */
+    int multipv;                /* number of best lines to score exactly */
+    int threads;                /* threads searching, 0 means 1 */
+    TranspositionTable *tt;     /* NULL means the engine default table */
+    EvalWeights *weights;       /* NULL means the default weights */
+    unsigned int seed;          /* of the tie-break between equal root moves,
+                                   0 means random */
+    U64 *history;               /* bitboard_key of the positions of the game
+                                   before this one, oldest first, for
+                                   repetitions; NULL means none */
+    int history_length;
+    void (*callback_best_move_found)(Move *);
+    void (*callback_iteration)(SearchResult *);  /* after each depth */
+} SearchOptions;
+
+/* a search running in the background, see engine_search_start */
+typedef struct search_t Search;
+
+/* turn: the color of the player to move */
+float get_best_move(Bitboard *b, Move *ptr_move_result,
     PieceColor turn, void (*callback_best_move_found)(Move *));
 
 float evaluate_one_move(Bitboard *b, Move *m, PieceColor turn);
 
+void init_search_options(SearchOptions *options);
+
+/*
+ * Iterative deepening search of the position, until one of the limits in
+ * options is reached. The result may be NULL. Returns the score of the best
+ * move.
+ */
+float engine_search(Bitboard *b, PieceColor turn, SearchOptions *options,
+    SearchResult *result);
+
+/*
+ * Multi-PV analysis: fills lines with the best n_lines root moves (at most),
+ * best first, each with its exact score and principal variation. All lines
+ * come from a single iterative deepening search. Returns the number of lines,
+ * 0 without searching if n_lines < 1.
+ */
+int engine_search_multipv(Bitboard *b, PieceColor turn,
+    SearchOptions *options, int n_lines, PVLine *lines);
+
+/*
+ * Background searches. The position is copied, so the caller may change or
+ * destroy b right after the call.
+ *
+ * - engine_search_start: begins the search in a new thread. If ponder is set,
+ *   time and node limits are ignored until engine_search_ponderhit.
+ * - engine_search_ponderhit: turns a ponder search into a normal search. The
+ *   clock for options.movetime starts at this point.
+ * - engine_search_stop: asks the search to stop as soon as possible.
+ * - engine_search_wait: waits for the search to finish, fills result (if not
+ *   NULL) and returns the score of the best move.
+ * - destroy_search: frees the search, stopping it if still running.
+ */
+Search *engine_search_start(Bitboard *b, PieceColor turn,
+    SearchOptions *options, int ponder);
+void engine_search_ponderhit(Search *s);
+void engine_search_stop(Search *s);
+float engine_search_wait(Search *s, SearchResult *result);
+void destroy_search(Search *s);
+
+/*
+ * Moves to mate for mate scores: positive if the player to move mates,
+ * negative if it gets mated. 0 for any other score.
+ */
+int engine_mate_in(float score);
+
+/*
+ * Ponder on the opponent's time.
+ *
+ * b is the position after our own move (last->best_move) was played, and
+ * turn is our color. The reply we expect (last->ponder_move) is played on a
+ * copy of b, and a ponder search of the resulting position is started.
+ * options->history ends before b, b itself is added to it.
+ *
+ * If the opponent plays last->ponder_move, call engine_search_ponderhit and
+ * then engine_search_wait to get our next move. Otherwise destroy the search
+ * and search the actual position: the transposition table keeps what was
+ * found meanwhile.
+ *
+ * Returns NULL if last has no ponder move.
+ */
+Search *engine_ponder_start(Bitboard *b, PieceColor turn, SearchResult *last,
+    SearchOptions *options);
+
 #endif
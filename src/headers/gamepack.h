@@ -0,0 +1,89 @@
+#ifndef GAMEPACK_h
+#define GAMEPACK_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "gamereader.h"
+
+/*
+ * Packed binary game files, to be replayed with no text parsing (see
+ * game_reader_replay_pack). Integers are stored in host byte order:
+ *
+ *   GamePackHeader
+ *   PackedGame, n_moves moves      (for each game, padded to 4 bytes)
+ *   ...
+ *   uint64_t offsets[n_games]      (index_offset points here)
+ *
+ * Moves take 16 bits: from cell (6), to cell (6), promotion (4). The
+ * promotion is one of the GAME_PACK_PROMOTE_* codes, its color is the one of
+ * the player moving. Only legal games are packed.
+ */
+
+#define GAME_PACK_MAGIC "SMOG"
+#define GAME_PACK_VERSION 1
+
+#define GAME_PACK_PROMOTE_NONE 0
+#define GAME_PACK_PROMOTE_QUEEN 1
+#define GAME_PACK_PROMOTE_ROOK 2
+#define GAME_PACK_PROMOTE_BISHOP 3
+#define GAME_PACK_PROMOTE_KNIGHT 4
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t n_games;
+    uint64_t index_offset;
+} GamePackHeader;
+
+typedef struct {
+    uint32_t n_moves;
+    uint16_t white_elo;
+    uint16_t black_elo;
+    uint8_t result;             /* a GameResult */
+    char eco[3];                /* not NUL terminated */
+} PackedGame;
+
+uint16_t game_pack_encode_move(Move *m);
+void game_pack_decode_move(uint16_t code, int is_white, Move *m);
+
+/*
+ * Writer: games are appended to f, which must be seekable. The header and the
+ * index are written by close_game_pack_writer, which returns 0 on errors.
+ */
+typedef struct game_pack_writer_t GamePackWriter;
+
+GamePackWriter *create_game_pack_writer(FILE *f);
+int game_pack_write_game(GamePackWriter *w, GameInfo *info,
+    uint16_t *moves, unsigned int n_moves);
+int close_game_pack_writer(GamePackWriter *w);
+
+/*
+ * Reader: the file is mapped, so games can be accessed at random. Returns
+ * NULL if fd is not a valid pack.
+ */
+typedef struct game_pack_t GamePack;
+
+GamePack *open_game_pack(int fd);
+void close_game_pack(GamePack *p);
+unsigned long long game_pack_count(GamePack *p);
+
+/*
+ * The moves of game n follow it, as (const uint16_t *)(game + 1). NULL if
+ * there is no game n, or if it does not fit in the file.
+ */
+const PackedGame *game_pack_get(GamePack *p, unsigned long long n);
+
+/*
+ * Replays count games of p, from game first, through the callbacks of r as
+ * game_reader_parse would. Packed games are legal, so moves are not checked,
+ * except that a move must take a piece of the side to move: on_illegal_move
+ * is only called for that, on a corrupted file. Games that do not fit in the
+ * file are skipped. Returns 1 when all games were replayed, 0 when a
+ * callback stopped the reader.
+ */
+int game_reader_replay_pack(GameReader *r, GamePack *p,
+    unsigned long long first, unsigned long long count);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef GAMEREADER_h
+#define GAMEREADER_h
+
+#include <stddef.h>
+
+#include "bitboard.h"
+
+/*
+ * Streaming reader of games in long algebraic notation (.whalg files):
+ *
+ *   [Event "Lloyds Bank op"]
+ *   [Result "1-0"]
+ *   [WhiteElo ""]
+ *   ...
+ *   1. e2-e4 e7-e6 2. d2-d4 d7-d5 ... 32. g5-h5+ 1-0
+ *
+ * Every game is replayed on the reader's own Bitboard, and reported through
+ * callbacks. Readers share no state, so several of them can run at the same
+ * time on different threads.
+ */
+
+typedef enum game_result_t {
+    GAME_RESULT_UNKNOWN,
+    GAME_RESULT_WHITE_WINS,
+    GAME_RESULT_BLACK_WINS,
+    GAME_RESULT_DRAW
+} GameResult;
+
+typedef struct {
+    unsigned long long index;   /* number of the game, from 0 */
+    GameResult result;          /* from the Result tag, then the move text */
+    int white_elo;              /* 0 if unknown */
+    int black_elo;
+    char eco[4];                /* empty if unknown */
+    unsigned int n_moves;       /* plies played so far */
+    int illegal;                /* set once a move was not legal */
+} GameInfo;
+
+/*
+ * Any callback may be NULL.
+ *
+ * - on_game_start: tags are parsed, the first move is about to be played.
+ * - on_move: b is the position after m. Return 0 to stop reading.
+ * - on_illegal_move: b is the position before m. Return 1 to skip the rest
+ *   of the game and go on with the next one, 0 to stop reading (also what
+ *   happens if the callback is NULL).
+ * - on_game_end: the result was read, or the game was interrupted.
+ */
+typedef struct {
+    void (*on_game_start)(GameInfo *info, void *user_data);
+    int (*on_move)(GameInfo *info, Bitboard *b, Move *m, void *user_data);
+    int (*on_illegal_move)(GameInfo *info, Bitboard *b, Move *m, void *user_data);
+    void (*on_game_end)(GameInfo *info, void *user_data);
+    void *user_data;
+} GameReaderCallbacks;
+
+typedef struct game_reader_t GameReader;
+
+GameReader *create_game_reader(GameReaderCallbacks *callbacks);
+void destroy_game_reader(GameReader *r);
+
+/*
+ * Both return 1 when all the input was read, 0 when a callback stopped the
+ * reader, -1 on I/O errors. Games may span consecutive calls to
+ * game_reader_parse, as long as the buffers are split between lines.
+ * game_reader_parse_fd maps the file if it can, and reads it in blocks
+ * otherwise (e.g., pipes).
+ */
+int game_reader_parse(GameReader *r, const char *data, size_t size);
+int game_reader_parse_fd(GameReader *r, int fd);
+
+/* ends the current game, if any, e.g. when the input has no final result */
+void game_reader_finish(GameReader *r);
+
+#endif
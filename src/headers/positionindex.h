@@ -0,0 +1,57 @@
+#ifndef POSITIONINDEX_h
+#define POSITIONINDEX_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "gamepack.h"
+
+/*
+ * Index from positions to the games reaching them. It is a table of entries
+ * sorted by (key, game_id, ply), with one entry for the position after each
+ * move of each game, keyed by bitboard_key. The file is:
+ *
+ *   PositionIndexHeader
+ *   PositionIndexEntry entries[n_entries]
+ *
+ * game_id is the number of the game in the pack the index was built from.
+ */
+
+#define POSITION_INDEX_MAGIC "SMOI"
+#define POSITION_INDEX_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t n_entries;
+} PositionIndexHeader;
+
+typedef struct {
+    uint64_t key;
+    uint32_t game_id;
+    uint16_t ply;               /* moves played to reach the position */
+    uint16_t reserved;
+} PositionIndexEntry;
+
+/*
+ * Replays all games of p, split among n_threads threads (0 means 1), and
+ * writes the index to f. Returns the number of entries, or -1 on errors.
+ */
+long long build_position_index(GamePack *p, FILE *f, int n_threads);
+
+typedef struct position_index_t PositionIndex;
+
+/* the file is mapped, returns NULL if fd is not a valid index */
+PositionIndex *open_position_index(int fd);
+void close_position_index(PositionIndex *idx);
+unsigned long long position_index_count(PositionIndex *idx);
+
+/*
+ * Binary search of key: returns the number of entries matching, and sets
+ * *first to the first one of them (sorted by game_id, then ply).
+ */
+unsigned long long position_index_find(PositionIndex *idx, U64 key,
+    const PositionIndexEntry **first);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef PROFILE_h
+#define PROFILE_h
+
+#include <stdio.h>
+
+/*
+ * Cycle counters for the hot functions of the engine, compiled in only with
+ * -DSMOENGINE_PROFILE (make PROFILE=1). Without it PROFILE_SCOPE expands to
+ * nothing, and profile_dump only says that profiling is off.
+ *
+ * A function is counted from its PROFILE_SCOPE line to its return. Ticks are
+ * rdtsc cycles on x86, nanoseconds elsewhere. Counters get the ticks spent in
+ * the function itself: the time spent in nested counted functions (e.g.
+ * get_attacks_to_square, from evaluate_bitboard) goes to those only.
+ *
+ * Each thread counts on its own, profile_dump adds all threads up. Counters of
+ * threads still running may be slightly behind.
+ */
+
+typedef enum {
+    PROFILE_GET_LEGAL_MOVES,
+    PROFILE_GET_ATTACKS_TO_SQUARE,
+    PROFILE_BITBOARD_DO_MOVE,
+    PROFILE_CLONE_BITBOARD,
+    PROFILE_EVALUATE_BITBOARD,
+    PROFILE_N_COUNTERS
+} ProfileCounter;
+
+#ifdef SMOENGINE_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define _profile_ticks() __rdtsc()
+#else
+#include <time.h>
+static inline unsigned long long _profile_ticks()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+typedef struct {
+    ProfileCounter counter;
+    unsigned long long start;
+    unsigned long long nested;  /* of the enclosing scope, restored at the end */
+} ProfileScope;
+
+/* ticks of the nested scopes that ended within the current one */
+extern __thread unsigned long long _profile_nested_ticks;
+
+static inline ProfileScope _profile_scope_begin(ProfileCounter counter)
+{
+    ProfileScope scope;
+    scope.counter = counter;
+    scope.nested = _profile_nested_ticks;
+    _profile_nested_ticks = 0;
+    scope.start = _profile_ticks();
+    return scope;
+}
+
+void _profile_record(ProfileCounter counter, unsigned long long self,
+    unsigned long long total);
+
+static inline void _profile_scope_end(ProfileScope *scope)
+{
+    unsigned long long total = _profile_ticks() - scope->start;
+    _profile_record(scope->counter, total - _profile_nested_ticks, total);
+    _profile_nested_ticks = scope->nested + total;
+}
+
+#define PROFILE_SCOPE(counter) \
+    ProfileScope _profile_scope __attribute__((cleanup(_profile_scope_end))) \
+        = _profile_scope_begin(counter)
+
+#else
+
+#define PROFILE_SCOPE(counter)
+
+#endif
+
+/* 1 if the counters were compiled in */
+int profile_enabled();
+
+/* sets the counters of all threads back to 0 */
+void profile_reset();
+
+/*
+ * Writes a table of the counters (calls, ticks in the function itself and
+ * including nested counted functions), then the histogram of the ticks per
+ * call of each function. Every line starts with prefix (e.g. "info string ").
+ */
+void profile_dump(FILE *f, const char *prefix);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TABLES_h
+#define TABLES_h
+
+#include "bitutils.h"
+
+/*
+ * Constant tables, indexed by cell (rank * 8 + file). They are generated at
+ * build time by src/tools/gen_tables.c into src/tables.c, so they need no
+ * initialization and are read only.
+ */
+
+typedef enum ray_direction_t {
+    RAY_NORTH,
+    RAY_NORTH_EAST,
+    RAY_EAST,
+    RAY_SOUTH_EAST,
+    RAY_SOUTH,
+    RAY_SOUTH_WEST,
+    RAY_WEST,
+    RAY_NORTH_WEST,
+    RAY_COUNT
+} RayDirection;
+
+/*
+ * Cells strictly between two cells on a rank, file or diagonal. For cells
+ * not on a line, the cells a king walks through going from the first to the
+ * second (diagonally first), see _mask_between.
+ */
+extern const U64 _between_masks[64][64];
+
+/* the whole rank, file or diagonal through two cells, 0 if not on a line */
+extern const U64 _line_masks[64][64];
+
+/* cells reached from a cell, up to the edge of the board (cell excluded) */
+extern const U64 _ray_masks[RAY_COUNT][64];
+
+extern const U64 _knight_attacks[64];
+extern const U64 _king_attacks[64];     /* without castling */
+
+/* captures of a pawn, indexed by PieceColor (white first) then cell */
+extern const U64 _pawn_attacks[2][64];
+
+/*
+ * Zobrist keys: pieces by PieceType (PIECE_TYPE_COUNT of them) then cell,
+ * castling rights in the order of _zobrist_rights, en-passant by file. They
+ * come from xorshift64* with a fixed seed, so that keys (and the position
+ * index files storing them) are the same across builds.
+ */
+extern const U64 _zobrist_piece[][64];
+extern const U64 _zobrist_castling[4];
+extern const U64 _zobrist_enpassant[8];
+extern const U64 _zobrist_black_to_move;
+
+#endif
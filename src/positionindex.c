@@ -0,0 +1,208 @@
+#include "positionindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* - - - - - - - - BUILDER - - - - - - - - */
+
+/* the games [first_game, last_game) and the slice of entries they fill */
+typedef struct {
+    GamePack *pack;
+    unsigned long long first_game;
+    unsigned long long last_game;
+    PositionIndexEntry *entries;
+    unsigned long long n_entries;
+} IndexRun;
+
+int _index_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    IndexRun *run = (IndexRun *)user_data;
+    PositionIndexEntry *e = &(run->entries[run->n_entries++]);
+
+    /* white moves when an even number of moves was played */
+    e->key = bitboard_key(b, (info->n_moves & 1)
+        ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE);
+    e->game_id = (uint32_t)info->index;
+    e->ply = (uint16_t)info->n_moves;
+    e->reserved = 0;
+    return 1;
+}
+
+int _compare_entries(const void *a, const void *b)
+{
+    const PositionIndexEntry *x = (const PositionIndexEntry *)a;
+    const PositionIndexEntry *y = (const PositionIndexEntry *)b;
+
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    if (x->game_id != y->game_id) return (x->game_id < y->game_id) ? -1 : 1;
+    return (int)x->ply - (int)y->ply;
+}
+
+/* the positions before the move are indexed, the rest of the game is not */
+int _skip_illegal_game(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    return 1;
+}
+
+void *_index_worker(void *arg)
+{
+    IndexRun *run = (IndexRun *)arg;
+    GameReaderCallbacks callbacks = { NULL, _index_move, _skip_illegal_game,
+        NULL, run };
+    GameReader *reader = create_game_reader(&callbacks);
+
+    game_reader_replay_pack(reader, run->pack, run->first_game,
+        run->last_game - run->first_game);
+    destroy_game_reader(reader);
+
+    qsort(run->entries, run->n_entries, sizeof(PositionIndexEntry),
+        &_compare_entries);
+    return NULL;
+}
+
+long long build_position_index(GamePack *p, FILE *f, int n_threads)
+{
+    unsigned long long n_games = game_pack_count(p);
+    unsigned long long n_entries = 0, n, i;
+    PositionIndexEntry *entries;
+    PositionIndexHeader header;
+    IndexRun *runs;
+    pthread_t *threads;
+    unsigned long long *heads;
+    int t, failed = 0;
+
+    if (n_threads < 1) n_threads = 1;
+    runs = malloc(n_threads * sizeof(IndexRun));
+    threads = malloc(n_threads * sizeof(pthread_t));
+    heads = malloc(n_threads * sizeof(unsigned long long));
+
+    /* game headers tell the size of each run in advance, at most */
+    for (n=0; n<n_games; n++) {
+        const PackedGame *game = game_pack_get(p, n);
+        if (game) n_entries += game->n_moves;
+    }
+    entries = malloc((n_entries ? n_entries : 1) * sizeof(PositionIndexEntry));
+
+    for (t=0, i=0, n=0; t<n_threads; t++) {
+        runs[t].pack = p;
+        runs[t].first_game = n;
+        runs[t].last_game = n_games * (t + 1) / n_threads;
+        runs[t].entries = entries + i;
+        runs[t].n_entries = 0;
+        for (; n < runs[t].last_game; n++) {
+            const PackedGame *game = game_pack_get(p, n);
+            if (game) i += game->n_moves;
+        }
+        pthread_create(&(threads[t]), NULL, &_index_worker, &(runs[t]));
+    }
+    /* games of a corrupted pack may be cut short */
+    for (t=0, n_entries=0; t<n_threads; t++) {
+        pthread_join(threads[t], NULL);
+        heads[t] = 0;
+        n_entries += runs[t].n_entries;
+    }
+
+    memcpy(header.magic, POSITION_INDEX_MAGIC, 4);
+    header.version = POSITION_INDEX_VERSION;
+    header.n_entries = n_entries;
+    if (fwrite(&header, sizeof(PositionIndexHeader), 1, f) != 1) failed = 1;
+
+    /* k-way merge of the sorted runs, there are few of them */
+    for (i=0; i<n_entries && !failed; i++) {
+        int best = -1;
+        for (t=0; t<n_threads; t++) {
+            if (heads[t] == runs[t].n_entries) continue;
+            if (best < 0 || _compare_entries(&(runs[t].entries[heads[t]]),
+                    &(runs[best].entries[heads[best]])) < 0) {
+                best = t;
+            }
+        }
+        if (fwrite(&(runs[best].entries[heads[best]++]),
+                sizeof(PositionIndexEntry), 1, f) != 1) {
+            failed = 1;
+        }
+    }
+    if (fflush(f) == EOF) failed = 1;
+
+    free(entries);
+    free(heads);
+    free(threads);
+    free(runs);
+    return failed ? -1 : (long long)n_entries;
+}
+
+/* - - - - - - - - QUERIES - - - - - - - - */
+
+struct position_index_t {
+    void *data;
+    size_t size;
+    const PositionIndexEntry *entries;
+    unsigned long long n_entries;
+};
+
+PositionIndex *open_position_index(int fd)
+{
+    PositionIndex *idx;
+    const PositionIndexHeader *header;
+    struct stat st;
+    void *data;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(PositionIndexHeader)) {
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return NULL;
+
+    header = (const PositionIndexHeader *)data;
+    if (memcmp(header->magic, POSITION_INDEX_MAGIC, 4)
+        || header->version != POSITION_INDEX_VERSION
+        || header->n_entries != (st.st_size - sizeof(PositionIndexHeader))
+            / sizeof(PositionIndexEntry)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    idx = malloc(sizeof(PositionIndex));
+    idx->data = data;
+    idx->size = st.st_size;
+    idx->entries = (const PositionIndexEntry *)(header + 1);
+    idx->n_entries = header->n_entries;
+    return idx;
+}
+
+void close_position_index(PositionIndex *idx)
+{
+    munmap(idx->data, idx->size);
+    free(idx);
+}
+
+unsigned long long position_index_count(PositionIndex *idx)
+{
+    return idx->n_entries;
+}
+
+/* the first entry with a key not less than key */
+unsigned long long _lower_bound(PositionIndex *idx, U64 key)
+{
+    unsigned long long lo = 0, hi = idx->n_entries;
+
+    while (lo < hi) {
+        unsigned long long mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+unsigned long long position_index_find(PositionIndex *idx, U64 key,
+    const PositionIndexEntry **first)
+{
+    unsigned long long lo = _lower_bound(idx, key);
+    unsigned long long hi = (key == ~0ULL) ? idx->n_entries : _lower_bound(idx, key + 1);
+
+    *first = &(idx->entries[lo]);
+    return hi - lo;
+}
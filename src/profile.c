@@ -0,0 +1,218 @@
+#include "profile.h"
+
+#ifdef SMOENGINE_PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* bucket k counts the calls that took less than 2^k ticks (and 2^(k-1) or more) */
+#define PROFILE_N_BUCKETS 65
+#define PROFILE_BAR_WIDTH 40
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_TICKS_UNIT "rdtsc cycles"
+#else
+#define PROFILE_TICKS_UNIT "ns"
+#endif
+
+const char *_profile_names[PROFILE_N_COUNTERS] = {
+    "get_legal_moves",
+    "get_attacks_to_square",
+    "bitboard_do_move",
+    "clone_bitboard",
+    "evaluate_bitboard"
+};
+
+typedef struct {
+    unsigned long long calls;
+    unsigned long long self_ticks;
+    unsigned long long total_ticks;
+    unsigned long long buckets[PROFILE_N_BUCKETS];
+} ProfileCounterData;
+
+typedef struct profile_block_t {
+    ProfileCounterData counters[PROFILE_N_COUNTERS];
+    struct profile_block_t *prev;
+    struct profile_block_t *next;
+} ProfileBlock;
+
+__thread unsigned long long _profile_nested_ticks = 0;
+__thread ProfileBlock *_profile_block = NULL;
+
+/* blocks of the running threads, and the sum of those that exited */
+pthread_mutex_t _profile_lock = PTHREAD_MUTEX_INITIALIZER;
+ProfileBlock *_profile_blocks = NULL;
+ProfileBlock _profile_retired;
+
+pthread_key_t _profile_key;
+pthread_once_t _profile_key_once = PTHREAD_ONCE_INIT;
+
+void _profile_add(ProfileBlock *dest, ProfileBlock *src)
+{
+    int c, k;
+    for (c=0; c<PROFILE_N_COUNTERS; c++) {
+        ProfileCounterData *d = &(dest->counters[c]);
+        ProfileCounterData *s = &(src->counters[c]);
+        d->calls += s->calls;
+        d->self_ticks += s->self_ticks;
+        d->total_ticks += s->total_ticks;
+        for (k=0; k<PROFILE_N_BUCKETS; k++) {
+            d->buckets[k] += s->buckets[k];
+        }
+    }
+}
+
+/* a thread exits: its counters are kept in _profile_retired */
+void _profile_thread_exit(void *arg)
+{
+    ProfileBlock *block = arg;
+
+    pthread_mutex_lock(&_profile_lock);
+    _profile_add(&_profile_retired, block);
+    if (block->prev) block->prev->next = block->next;
+    else _profile_blocks = block->next;
+    if (block->next) block->next->prev = block->prev;
+    pthread_mutex_unlock(&_profile_lock);
+    free(block);
+}
+
+void _profile_create_key()
+{
+    pthread_key_create(&_profile_key, _profile_thread_exit);
+}
+
+ProfileBlock *_profile_thread_block()
+{
+    ProfileBlock *block = calloc(1, sizeof(ProfileBlock));
+
+    pthread_once(&_profile_key_once, _profile_create_key);
+    pthread_setspecific(_profile_key, block);
+
+    pthread_mutex_lock(&_profile_lock);
+    block->next = _profile_blocks;
+    if (_profile_blocks) _profile_blocks->prev = block;
+    _profile_blocks = block;
+    pthread_mutex_unlock(&_profile_lock);
+
+    _profile_block = block;
+    return block;
+}
+
+void _profile_record(ProfileCounter counter, unsigned long long self,
+    unsigned long long total)
+{
+    ProfileBlock *block = _profile_block ? _profile_block : _profile_thread_block();
+    ProfileCounterData *d = &(block->counters[counter]);
+
+    d->calls++;
+    d->self_ticks += self;
+    d->total_ticks += total;
+    d->buckets[self ? 64 - __builtin_clzll(self) : 0]++;
+}
+
+int profile_enabled()
+{
+    return 1;
+}
+
+void profile_reset()
+{
+    ProfileBlock *block;
+
+    pthread_mutex_lock(&_profile_lock);
+    memset(_profile_retired.counters, 0, sizeof(_profile_retired.counters));
+    for (block=_profile_blocks; block; block=block->next) {
+        memset(block->counters, 0, sizeof(block->counters));
+    }
+    pthread_mutex_unlock(&_profile_lock);
+}
+
+/* upper bound of the bucket holding the p-th percentile of the calls */
+unsigned long long _profile_percentile(ProfileCounterData *d, int p)
+{
+    unsigned long long seen = 0, rank = (d->calls * p + 99) / 100;
+    int k;
+
+    for (k=0; k<PROFILE_N_BUCKETS; k++) {
+        seen += d->buckets[k];
+        if (seen >= rank) break;
+    }
+    return k ? (1ULL << (k - 1)) * 2 - 1 : 0;
+}
+
+void profile_dump(FILE *f, const char *prefix)
+{
+    ProfileBlock sum, *block;
+    unsigned long long all_self = 0, max_bucket;
+    int c, k, first, last;
+
+    memset(&sum, 0, sizeof(ProfileBlock));
+    pthread_mutex_lock(&_profile_lock);
+    _profile_add(&sum, &_profile_retired);
+    for (block=_profile_blocks; block; block=block->next) {
+        _profile_add(&sum, block);
+    }
+    pthread_mutex_unlock(&_profile_lock);
+
+    for (c=0; c<PROFILE_N_COUNTERS; c++) {
+        all_self += sum.counters[c].self_ticks;
+    }
+
+    fprintf(f, "%sprofile, ticks are %s\n", prefix, PROFILE_TICKS_UNIT);
+    fprintf(f, "%s%-22s %12s %16s %6s %10s %10s %8s %8s\n", prefix, "function",
+        "calls", "self ticks", "share", "self/call", "total/call", "p50 <=", "p99 <=");
+    for (c=0; c<PROFILE_N_COUNTERS; c++) {
+        ProfileCounterData *d = &(sum.counters[c]);
+        fprintf(f, "%s%-22s %12llu %16llu %5.1f%% %10.1f %10.1f %8llu %8llu\n",
+            prefix, _profile_names[c], d->calls, d->self_ticks,
+            all_self ? 100.0 * d->self_ticks / all_self : 0.0,
+            d->calls ? (double)d->self_ticks / d->calls : 0.0,
+            d->calls ? (double)d->total_ticks / d->calls : 0.0,
+            _profile_percentile(d, 50), _profile_percentile(d, 99));
+    }
+
+    /* histograms, from the first to the last bucket used */
+    for (c=0; c<PROFILE_N_COUNTERS; c++) {
+        ProfileCounterData *d = &(sum.counters[c]);
+        if (!d->calls) continue;
+
+        first = last = -1;
+        max_bucket = 0;
+        for (k=0; k<PROFILE_N_BUCKETS; k++) {
+            if (!d->buckets[k]) continue;
+            if (first < 0) first = k;
+            last = k;
+            if (d->buckets[k] > max_bucket) max_bucket = d->buckets[k];
+        }
+
+        fprintf(f, "%s%s, self ticks per call:\n", prefix, _profile_names[c]);
+        for (k=first; k<=last; k++) {
+            int width = (int)(PROFILE_BAR_WIDTH * d->buckets[k] / max_bucket);
+            fprintf(f, "%s  < %-20llu %12llu %5.1f%% %.*s\n", prefix,
+                k < 64 ? 1ULL << k : ~0ULL, d->buckets[k],
+                100.0 * d->buckets[k] / d->calls,
+                width, "########################################");
+        }
+    }
+    fflush(f);
+}
+
+#else
+
+int profile_enabled()
+{
+    return 0;
+}
+
+void profile_reset()
+{
+}
+
+void profile_dump(FILE *f, const char *prefix)
+{
+    fprintf(f, "%sprofile: not compiled in, build with make PROFILE=1\n", prefix);
+    fflush(f);
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "minunit.h"
 
 #include "test_common.h"
+#include "attacks.h"
 
 /* - - - - - - -  Tests for bitboards - - - - - - - - */
 int tests_run = 0;
@@ -361,6 +363,408 @@ static char *test_legal() {
     return 0;
 }
 
+static char *test_zobrist() {
+    Move m;
+    init_move(&m);
+    Bitboard *b = create_test_bitboard();
+    U64 initial_key = b->hash;
+    mu_assert("Key computed on creation", b->hash == bitboard_compute_hash(b));
+    mu_assert("Side to move changes the key", 
+        bitboard_key(b, PIECE_COLOR_WHITE) != bitboard_key(b, PIECE_COLOR_BLACK));
+
+    m.from_file = FILE_E; /* e2-e4 */
+    m.from_rank = RANK_2;
+    m.to_file = FILE_E;
+    m.to_rank = RANK_4;
+    bitboard_do_move(b, &m);
+    mu_assert("Key updated after pawn longstep", b->hash == bitboard_compute_hash(b));
+    mu_assert("Key changes after a move", b->hash != initial_key);
+
+    m.from_file = FILE_G; /* g8-f6 */
+    m.from_rank = RANK_8;
+    m.to_file = FILE_F;
+    m.to_rank = RANK_6;
+    bitboard_do_move(b, &m);
+    m.from_file = FILE_E; /* e4-e5 */
+    m.from_rank = RANK_4;
+    m.to_file = FILE_E;
+    m.to_rank = RANK_5;
+    bitboard_do_move(b, &m);
+    m.from_file = FILE_F; /* f6-e4 */
+    m.from_rank = RANK_6;
+    m.to_file = FILE_E;
+    m.to_rank = RANK_4;
+    bitboard_do_move(b, &m);
+    m.from_file = FILE_G; /* g1-f3 */
+    m.from_rank = RANK_1;
+    m.to_file = FILE_F;
+    m.to_rank = RANK_3;
+    bitboard_do_move(b, &m);
+    m.from_file = FILE_D; /* d7-d5 */
+    m.from_rank = RANK_7;
+    m.to_file = FILE_D;
+    m.to_rank = RANK_5;
+    bitboard_do_move(b, &m);
+    m.from_file = FILE_E; /* e5-d6 e.p. */
+    m.from_rank = RANK_5;
+    m.to_file = FILE_D;
+    m.to_rank = RANK_6;
+    bitboard_do_move(b, &m);
+    mu_assert("Key updated after en-passant", b->hash == bitboard_compute_hash(b));
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_fen() {
+    char fen[FEN_MAX_LENGTH];
+    Move m;
+    init_move(&m);
+    Bitboard *initial = create_test_bitboard();
+    Bitboard *b = bitboard_from_fen(FEN_INITIAL_POSITION);
+
+    mu_assert("Initial position parsed", b != NULL);
+    mu_assert("Same pieces as create_bitboard", !memcmp(b->position,
+        initial->position, sizeof(b->position)));
+    mu_assert("Same key as create_bitboard", b->hash == initial->hash);
+    bitboard_to_fen(b, fen);
+    mu_assert("Initial position written back", !strcmp(fen, FEN_INITIAL_POSITION));
+
+    m.from_file = FILE_E; /* e2-e4 */
+    m.from_rank = RANK_2;
+    m.to_file = FILE_E;
+    m.to_rank = RANK_4;
+    bitboard_do_move(b, &m);
+    bitboard_to_fen(b, fen);
+    mu_assert("Side to move and no en-passant square after e2-e4", !strcmp(fen,
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"));
+    destroy_bitboard(b);
+
+    b = bitboard_from_fen("r3k2r/8/8/3pP3/8/8/8/4K2R w Kq d6 3 40");
+    mu_assert("Position parsed", b != NULL);
+    mu_assert("Key computed on parsing", b->hash == bitboard_compute_hash(b));
+    mu_assert("Castling rights as in the FEN",
+        b->white_castling_rights == MASK_WHITE_KING_RIGHT_CASTLE
+        && b->black_castling_rights == MASK_BLACK_KING_LEFT_CASTLE);
+    m.from_file = FILE_E; /* e5-d6 e.p. */
+    m.from_rank = RANK_5;
+    m.to_file = FILE_D;
+    m.to_rank = RANK_6;
+    mu_assert("En-passant capture is legal", is_legal_move(b, &m));
+    bitboard_to_fen(b, fen);
+    mu_assert("Position written back",
+        !strcmp(fen, "r3k2r/8/8/3pP3/8/8/8/4K2R w Kq d6 3 40"));
+    destroy_bitboard(b);
+
+    mu_assert("Counters are optional", bitboard_set_fen(initial,
+        "8/8/8/8/8/8/8/K6k b - -") && initial->fullmove_number == 1);
+    mu_assert("Bad rank rejected", !bitboard_from_fen("8/8/8/8/8/8/9/K6k w - - 0 1"));
+    mu_assert("Missing rank rejected", !bitboard_from_fen("8/8/8/8/8/8/K6k w - - 0 1"));
+    mu_assert("Bad side rejected", !bitboard_from_fen("8/8/8/8/8/8/8/K6k x - - 0 1"));
+    destroy_bitboard(initial);
+    return 0;
+}
+
+/* plays the moves from the FEN, then checks the FEN and key of the result */
+static int _fen_after_moves(const char *start, const char **moves, int n,
+    const char *expected)
+{
+    char fen[FEN_MAX_LENGTH];
+    Bitboard *b = bitboard_from_fen(start), *parsed;
+    Move m;
+    int i, ok;
+
+    for (i=0; i<n; i++) {
+        move_from_string(b, moves[i], &m);
+        bitboard_do_move(b, &m);
+    }
+    bitboard_to_fen(b, fen);
+    parsed = bitboard_from_fen(expected);
+    ok = !strcmp(fen, expected) && parsed && parsed->hash == b->hash
+        && b->hash == bitboard_compute_hash(b);
+    destroy_bitboard(b);
+    if (parsed) destroy_bitboard(parsed);
+    return ok;
+}
+
+static char *test_fen_enpassant() {
+    const char *d3[] = {"d2d3"};
+    const char *e4[] = {"e2e4"};
+    const char *d5[] = {"e2e4", "a7a6", "e4e5", "d7d5"};
+    const char *dxe3[] = {"d2e3"};
+    Bitboard *b1, *b2;
+
+    mu_assert("No en-passant square after a single step", _fen_after_moves(
+        FEN_INITIAL_POSITION, d3, 1,
+        "rnbqkbnr/pppppppp/8/8/8/3P4/PPP1PPPP/RNBQKBNR b KQkq - 0 1"));
+    mu_assert("No en-passant square if no pawn can capture", _fen_after_moves(
+        FEN_INITIAL_POSITION, e4, 1,
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"));
+    mu_assert("En-passant square if a pawn can capture", _fen_after_moves(
+        FEN_INITIAL_POSITION, d5, 4,
+        "rnbqkbnr/1pp1pppp/p7/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 3"));
+    mu_assert("No en-passant square after a capture from the second rank",
+        _fen_after_moves("4k3/8/8/8/8/4n3/3P4/4K3 w - - 0 1", dxe3, 1,
+        "4k3/8/8/8/8/4P3/8/4K3 b - - 0 1"));
+
+    b1 = bitboard_from_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    b2 = bitboard_from_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    mu_assert("En-passant square nobody can take is dropped",
+        !b1->enpassant_rights && b1->hash == b2->hash);
+    destroy_bitboard(b1);
+    destroy_bitboard(b2);
+    return 0;
+}
+
+static char *test_san() {
+    char san[8];
+    Move m;
+    init_move(&m);
+    Bitboard *b = bitboard_from_fen("r3k3/1P6/8/R2p4/4P3/5N2/8/RN2K2R w K - 0 1");
+
+    m.from_file = FILE_B; /* b1-d2 */
+    m.from_rank = RANK_1;
+    m.to_file = FILE_D;
+    m.to_rank = RANK_2;
+    move_to_san(b, &m, san);
+    mu_assert("Knight disambiguated by file", !strcmp(san, "Nbd2"));
+
+    m.from_file = FILE_A; /* a1-a3 */
+    m.to_file = FILE_A;
+    m.to_rank = RANK_3;
+    move_to_san(b, &m, san);
+    mu_assert("Rook disambiguated by rank", !strcmp(san, "R1a3"));
+
+    m.from_file = FILE_E; /* e4xd5 */
+    m.from_rank = RANK_4;
+    m.to_file = FILE_D;
+    m.to_rank = RANK_5;
+    move_to_san(b, &m, san);
+    mu_assert("Pawn capture", !strcmp(san, "exd5"));
+
+    m.from_file = FILE_B; /* b7xa8=N */
+    m.from_rank = RANK_7;
+    m.to_file = FILE_A;
+    m.to_rank = RANK_8;
+    m.promote_to = WHITE_KNIGHT;
+    move_to_san(b, &m, san);
+    mu_assert("Promotion with capture", !strcmp(san, "bxa8=N"));
+
+    mu_assert("Castling parsed", move_from_san(b, "0-0", &m)
+        && m.from_file == FILE_E && m.to_file == FILE_G && m.to_rank == RANK_1);
+    mu_assert("Check marks ignored", move_from_san(b, "R5a3+", &m)
+        && m.from_rank == RANK_5 && m.to_rank == RANK_3);
+    mu_assert("Promotion parsed", move_from_san(b, "b8=Q", &m)
+        && m.promote_to == WHITE_QUEEN);
+    mu_assert("Ambiguous move rejected", !move_from_san(b, "Nd2", &m));
+    mu_assert("Illegal move rejected", !move_from_san(b, "Qd1", &m));
+
+    mu_assert("Coordinates parsed", move_from_string(b, "b7a8q", &m)
+        && m.from_file == FILE_B && m.to_rank == RANK_8 && m.promote_to == WHITE_QUEEN);
+    mu_assert("Empty cell rejected", !move_from_string(b, "e3e4", &m));
+    mu_assert("Piece of the opponent rejected", !move_from_string(b, "d5d4", &m));
+    mu_assert("Bad syntax rejected", !move_from_string(b, "e9e4", &m));
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_setwise_attacks() {
+    const char *fens[] = {
+        FEN_INITIAL_POSITION,
+        "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 1 5",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        NULL
+    };
+    int i, cell;
+
+    for (i=0; fens[i]; i++) {
+        Bitboard *b = bitboard_from_fen(fens[i]);
+        U64 white = bitboard_get_attacks_by(b, PIECE_COLOR_WHITE);
+        U64 black = bitboard_get_attacks_by(b, PIECE_COLOR_BLACK);
+        U64 center = 0x0ULL;
+
+        for (cell=0; cell<64; cell++) {
+            U64 attackers = get_attacks_to_square(b, _FILE(cell), _RANK(cell));
+            U64 bit = 1ULL << cell;
+
+            mu_assert("Attackers to a single cell",
+                bitboard_get_attackers_to(b, bit) == attackers);
+            mu_assert("Cells attacked by white",
+                !!(white & bit) == !!(attackers & bitboard_get_white_positions(b)));
+            mu_assert("Cells attacked by black",
+                !!(black & bit) == !!(attackers & bitboard_get_black_positions(b)));
+            if (bit & MASK_CENTER_4SQ) center |= attackers;
+        }
+        mu_assert("Center attackers in one pass",
+            bitboard_get_center_attackers(b) == center);
+        destroy_bitboard(b);
+    }
+    return 0;
+}
+
+static char *test_king_legality() {
+    Bitboard *b;
+    Move m;
+
+#define KING_MOVES(fen, file, rank) \
+    (bitboard_set_fen(b, fen), get_legal_moves(b, file, rank))
+
+    b = bitboard_from_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+    mu_assert("Castling both sides",
+        get_legal_moves(b, FILE_E, RANK_1) == (0x6CULL | 0x3800ULL));
+    mu_assert("Attack maps cached", b->attack_maps_valid);
+    mu_assert("Cached white attack map",
+        bitboard_get_attack_map(b, PIECE_COLOR_WHITE)
+            == bitboard_get_attacks_by(b, PIECE_COLOR_WHITE));
+    mu_assert("Cached attacks of a piece type",
+        bitboard_get_piece_attacks(b, WHITE_ROOK)
+            == get_rook_attacks_setwise(b->position[WHITE_ROOK],
+                ~bitboard_get_all_positions(b)));
+    mu_assert("Cached attacks of a black piece type",
+        bitboard_get_piece_attacks(b, BLACK_KING)
+            == get_king_attacks_setwise(b->position[BLACK_KING]));
+
+    init_move(&m);
+    m.from_file = FILE_A; m.from_rank = RANK_1;
+    m.to_file = FILE_A; m.to_rank = RANK_2;
+    bitboard_do_move(b, &m);
+    mu_assert("Attack maps dropped by a move", !b->attack_maps_valid);
+    mu_assert("Black castling after the move",
+        get_legal_moves(b, FILE_E, RANK_8) == (0x6CULL << 56 | 0x38ULL << 48));
+
+    mu_assert("No castling through an attacked cell",
+        KING_MOVES("r3kr2/8/8/8/8/8/8/R3K2R w KQq - 0 1", FILE_E, RANK_1)
+            == (0x0CULL | 0x1800ULL));
+    mu_assert("No castling with a piece between king and rook",
+        KING_MOVES("r3k2r/8/8/8/8/8/8/RN2K2R w KQkq - 0 1", FILE_E, RANK_1)
+            == (0x68ULL | 0x3800ULL));
+    mu_assert("No castling out of check, nor along the check",
+        KING_MOVES("r3k2r/8/8/8/4r3/8/8/R3K2R w KQk - 0 1", FILE_E, RANK_1)
+            == (0x28ULL | 0x2800ULL));
+    mu_assert("A knight check can't be blocked",
+        KING_MOVES("4k3/8/8/8/8/3n4/R7/4K3 w - - 0 1", FILE_A, RANK_2) == 0x0ULL);
+
+#undef KING_MOVES
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_check_and_mate() {
+    Bitboard *b = bitboard_from_fen(FEN_INITIAL_POSITION);
+
+    mu_assert("Initial position, no check",
+        !bitboard_is_in_check(b, PIECE_COLOR_WHITE) && !bitboard_is_in_check(b, PIECE_COLOR_BLACK));
+    mu_assert("Initial position, legal moves", bitboard_has_legal_move(b, PIECE_COLOR_WHITE));
+
+    bitboard_set_fen(b, "7k/6Q1/6K1/8/8/8/8/8 b - - 0 1");
+    mu_assert("Checkmate",
+        bitboard_is_in_check(b, PIECE_COLOR_BLACK) && !bitboard_has_legal_move(b, PIECE_COLOR_BLACK));
+    mu_assert("The winner is not in check", !bitboard_is_in_check(b, PIECE_COLOR_WHITE));
+
+    bitboard_set_fen(b, "7k/8/6Q1/8/8/8/8/6K1 b - - 0 1");
+    mu_assert("Stalemate",
+        !bitboard_is_in_check(b, PIECE_COLOR_BLACK) && !bitboard_has_legal_move(b, PIECE_COLOR_BLACK));
+
+    bitboard_set_fen(b, "7k/8/5Q2/8/8/8/8/6K1 b - - 0 1");
+    mu_assert("King can move", bitboard_has_legal_move(b, PIECE_COLOR_BLACK));
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_pseudo_legal() {
+    const char *fens[] = {
+        FEN_INITIAL_POSITION,
+        "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 1 5",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        NULL
+    };
+    int i, from, to;
+    Bitboard *b;
+    Move m;
+
+    for (i=0; fens[i]; i++) {
+        b = bitboard_from_fen(fens[i]);
+        U64 own = (b->turn == PIECE_COLOR_WHITE)
+            ? bitboard_get_white_positions(b) : bitboard_get_black_positions(b);
+
+        for (from=0; from<64; from++) {
+            if (!(own & (1ULL << from))) continue;
+            for (to=0; to<64; to++) {
+                PieceType t = b->piece_type[from];
+                int pseudo_legal_and_safe;
+
+                init_move(&m);
+                m.from_file = _FILE(from); m.from_rank = _RANK(from);
+                m.to_file = _FILE(to); m.to_rank = _RANK(to);
+                if ((t == WHITE_PAWN && m.to_rank == RANK_8)
+                    || (t == BLACK_PAWN && m.to_rank == RANK_1)) {
+                    m.promote_to = t + (WHITE_QUEEN - WHITE_PAWN);
+                }
+
+                pseudo_legal_and_safe = bitboard_is_pseudo_legal(b, &m);
+                if (pseudo_legal_and_safe) {
+                    Bitboard *b1 = clone_bitboard(b);
+                    bitboard_do_move(b1, &m);
+                    pseudo_legal_and_safe = !bitboard_is_in_check(b1, b->turn);
+                    destroy_bitboard(b1);
+                }
+                mu_assert("Pseudo-legal and king safe, same as legal",
+                    pseudo_legal_and_safe == is_legal_move(b, &m));
+            }
+        }
+        destroy_bitboard(b);
+    }
+
+    b = bitboard_from_fen(FEN_INITIAL_POSITION);
+    init_move(&m);
+    m.from_file = FILE_E; m.from_rank = RANK_2;
+    m.to_file = FILE_E; m.to_rank = RANK_4;
+    m.promote_to = WHITE_QUEEN;
+    mu_assert("No promotion before the last rank", !bitboard_is_pseudo_legal(b, &m));
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_pool() {
+    BitboardPoolStats stats;
+    BitboardPool *pool = create_bitboard_pool(2);
+    Bitboard *outside = create_test_bitboard();
+    Bitboard *a, *b, *c;
+
+    bitboard_pool_attach(pool);
+    mu_assert("Pool attached", bitboard_pool_attached() == pool);
+
+    a = clone_bitboard(outside);
+    b = create_blank_bitboard();
+    c = clone_bitboard(a);
+    mu_assert("Clones are copies", !memcmp(c, outside, sizeof(Bitboard)));
+    mu_assert("Boards are cache aligned", !((unsigned long)a % 64)
+        && !((unsigned long)c % 64));
+    bitboard_pool_stats(pool, &stats);
+    mu_assert("Allocations counted", stats.allocations == 3 && stats.in_use == 3);
+    mu_assert("Slabs allocated as needed", stats.slabs == 2);
+
+    destroy_bitboard(b);
+    mu_assert("Destroyed boards reused", create_blank_bitboard() == b);
+    destroy_bitboard(outside);     /* not from the pool */
+
+    bitboard_pool_reset(pool);
+    bitboard_pool_stats(pool, &stats);
+    mu_assert("Reset gives back all boards", stats.in_use == 0
+        && stats.peak_in_use == 3 && stats.resets == 1);
+    mu_assert("Slabs reused after reset", clone_bitboard(c) == a);
+    bitboard_pool_stats(pool, &stats);
+    mu_assert("No slab added after reset", stats.slabs == 2);
+
+    bitboard_pool_attach(NULL);
+    destroy_bitboard_pool(pool);
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_cell_enumeration);
     mu_run_test(test_masks);
@@ -368,6 +772,15 @@ static char *all_tests() {
     mu_run_test(test_64_bits_arithmetics);
     mu_run_test(test_bitboard_positions);
     mu_run_test(test_legal);
+    mu_run_test(test_zobrist);
+    mu_run_test(test_fen);
+    mu_run_test(test_san);
+    mu_run_test(test_pool);
+    mu_run_test(test_setwise_attacks);
+    mu_run_test(test_king_legality);
+    mu_run_test(test_check_and_mate);
+    mu_run_test(test_pseudo_legal);
+    mu_run_test(test_fen_enpassant);
     return 0;
 }
 
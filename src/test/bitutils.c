@@ -4,6 +4,7 @@
 
 #include "bitutils.h"
 #include "bitboard.h"
+#include "tables.h"
 
 
 int tests_run = 0;
@@ -25,10 +26,22 @@ static char *test_mask_between() {
     return 0;
 }
 
+static char *test_tables() {
+    mu_assert("knight attacks from a1", _knight_attacks[0] == ((1ULL << 10) | (1ULL << 17)));
+    mu_assert("king attacks from h8", _king_attacks[63] == 0x40C0000000000000ULL);
+    mu_assert("white pawn attacks from e4", _pawn_attacks[0][28] == ((1ULL << 35) | (1ULL << 37)));
+    mu_assert("black pawn attacks from a5", _pawn_attacks[1][32] == (1ULL << 25));
+    mu_assert("line through a1 and h8", _line_masks[0][63] == 0x8040201008040201ULL);
+    mu_assert("line through a1 and c2", _line_masks[0][10] == 0x0ULL);
+    mu_assert("ray north from a1", _ray_masks[RAY_NORTH][0] == 0x0101010101010100ULL);
+    mu_assert("ray south west from h8", _ray_masks[RAY_SOUTH_WEST][63] == 0x0040201008040201ULL);
+    return 0;
+}
 
 static char *all_tests() {
     mu_run_test(test_cell_of_bit);
     mu_run_test(test_mask_between);
+    mu_run_test(test_tables);
     return 0;
 }
 
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <strings.h>
 #include "minunit.h"
 
 #include "test_common.h"
@@ -18,8 +19,272 @@ static char *test_get_best_move() {
 }
 
 
+static char *test_ponder() {
+    SearchOptions options;
+    SearchResult result, ponder_result;
+    Search *ponder;
+    Bitboard *b = create_test_bitboard();
+
+    init_search_options(&options);
+    options.depth = 3;
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("search completed", result.depth == 3);
+    mu_assert("expected reply found", result.has_ponder_move);
+
+    bitboard_do_move(b, &(result.best_move));
+
+    /* the opponent plays the expected reply */
+    ponder = engine_ponder_start(b, PIECE_COLOR_WHITE, &result, &options);
+    mu_assert("ponder search started", ponder != NULL);
+    bitboard_do_move(b, &(result.ponder_move));
+    engine_search_ponderhit(ponder);
+    engine_search_wait(ponder, &ponder_result);
+    destroy_search(ponder);
+    mu_assert("ponder hit completes the search", ponder_result.depth == 3);
+    mu_assert("ponder hit move is legal", is_legal_move(b, &(ponder_result.best_move)));
+
+    /* the opponent plays something else */
+    options.depth = 0;
+    options.movetime = 60000;
+    ponder = engine_ponder_start(b, PIECE_COLOR_BLACK, &ponder_result, &options);
+    mu_assert("second ponder search started", ponder != NULL);
+    destroy_search(ponder);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_multipv() {
+    SearchOptions options;
+    PVLine lines[3];
+    int n, i;
+    Bitboard *b = create_test_bitboard();
+
+    init_search_options(&options);
+    options.depth = 3;
+    engine_clear_hash();
+    n = engine_search_multipv(b, PIECE_COLOR_WHITE, &options, 3, lines);
+    mu_assert("three lines returned", n == 3);
+    for (i=0; i<n; i++) {
+        mu_assert("line starts with its move", is_same_move(&(lines[i].pv[0]), &(lines[i].move)));
+        mu_assert("line has the full depth", lines[i].pv_length == 3);
+        mu_assert("line move is legal", is_legal_move(b, &(lines[i].move)));
+        if (i) {
+            mu_assert("lines sorted by score", lines[i - 1].score >= lines[i].score);
+            mu_assert("lines are different moves", !is_same_move(&(lines[i - 1].move), &(lines[i].move)));
+        }
+    }
+    mu_assert("no line asked, none returned",
+        engine_search_multipv(b, PIECE_COLOR_WHITE, &options, 0, NULL) == 0);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_threads() {
+    SearchOptions options;
+    SearchResult result;
+    Bitboard *b = create_test_bitboard();
+
+    init_search_options(&options);
+    options.depth = 3;
+    options.threads = 3;
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("threaded search completed", result.depth == 3);
+    mu_assert("threaded search move is legal", is_legal_move(b, &(result.best_move)));
+    mu_assert("helper stats are merged",
+        result.stats.nodes + result.stats.qnodes == result.nodes);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_search_stats() {
+    SearchOptions options;
+    SearchResult result;
+    Bitboard *b = create_test_bitboard();
+    unsigned long long iteration_nodes = 0;
+    float rate;
+    int depth;
+
+    init_search_options(&options);
+    options.depth = 3;
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+
+    mu_assert("stats count every node",
+        result.stats.nodes + result.stats.qnodes == result.nodes);
+    mu_assert("stats depth", result.stats.depth == result.depth);
+    for (depth=1; depth<=result.stats.depth; depth++) {
+        iteration_nodes += result.stats.depth_nodes[depth];
+    }
+    mu_assert("iterations add up to the nodes", iteration_nodes == result.nodes);
+    mu_assert("cutoffs counted", result.stats.cutoffs > 0
+        && result.stats.first_move_cutoffs <= result.stats.cutoffs);
+    rate = search_stats_first_move_cutoff_rate(&(result.stats));
+    mu_assert("cutoff rate", rate > 0.0f && rate <= 1.0f);
+    mu_assert("branching factor", search_stats_branching_factor(&(result.stats)) > 0.0f);
+    mu_assert("movegen and eval counted",
+        result.stats.movegen_calls > 0 && result.stats.eval_calls > 0);
+    mu_assert("tt probes counted", result.stats.tt_probes > 0
+        && result.stats.tt_probes <= result.stats.nodes);
+    mu_assert("tt hits counted", result.stats.tt_hits > 0
+        && result.stats.tt_cutoffs <= result.stats.tt_hits
+        && result.stats.tt_hits <= result.stats.tt_probes);
+
+    /* the same search again finds its own entries */
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("tt cutoffs counted", result.stats.tt_cutoffs > 0
+        && result.stats.tt_cutoffs <= result.stats.tt_hits);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_eval_terms() {
+    EvalWeights w, only;
+    Bitboard *b = bitboard_from_fen(
+        "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    Bitboard *mirror = bitboard_from_fen(
+        "rnbqkb1r/pppp1ppp/5n2/4p3/4P3/2N5/PPPP1PPP/R1BQKBNR b KQkq - 2 3");
+    Bitboard *attack = bitboard_from_fen("6k1/5ppp/8/3Q4/8/8/5PPP/6K1 w - - 0 1");
+    Bitboard *initial = create_test_bitboard();
+
+    init_eval_weights(&w);
+    mu_assert("initial position is even",
+        evaluate_bitboard_weights(initial, PIECE_COLOR_WHITE, &w) == 0.0f);
+    mu_assert("mirrored position, same score for the other side",
+        evaluate_bitboard_weights(b, PIECE_COLOR_WHITE, &w)
+            == evaluate_bitboard_weights(mirror, PIECE_COLOR_BLACK, &w));
+
+    /* the queen attacks f7, next to the black king */
+    bzero(&only, sizeof(EvalWeights));
+    only.king_zone_attacks = 1.0f;
+    mu_assert("king zone attacks",
+        evaluate_bitboard_weights(attack, PIECE_COLOR_WHITE, &only) == 1.0f);
+
+    /* d4, e4 and e5, from the queen attacks cached in the position */
+    bzero(&only, sizeof(EvalWeights));
+    only.center_attackers = 1.0f;
+    mu_assert("center attackers",
+        evaluate_bitboard_weights(attack, PIECE_COLOR_WHITE, &only) == 3.0f);
+
+    /* 7 cells on the d file, 7 on the rank, 10 on the diagonals */
+    bzero(&only, sizeof(EvalWeights));
+    only.mobility_queen = 1.0f;
+    mu_assert("queen mobility",
+        evaluate_bitboard_weights(attack, PIECE_COLOR_WHITE, &only) == 24.0f);
+
+    destroy_bitboard(b);
+    destroy_bitboard(mirror);
+    destroy_bitboard(attack);
+    destroy_bitboard(initial);
+    return 0;
+}
+
+static char *test_see() {
+    Move m;
+    Bitboard *b = bitboard_from_fen("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1");
+
+    init_move(&m);
+    m.from_file = FILE_E; m.from_rank = RANK_1;
+    m.to_file = FILE_E; m.to_rank = RANK_5;
+    mu_assert("undefended pawn", bitboard_see(b, &m) == 100);
+
+    m.from_file = FILE_C; m.from_rank = RANK_2;
+    m.to_file = FILE_C; m.to_rank = RANK_3;
+    mu_assert("quiet move", bitboard_see(b, &m) == 0);
+
+    /* the queens join in behind the rook and the bishop */
+    bitboard_set_fen(b, "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1");
+    m.from_file = FILE_D; m.from_rank = RANK_3;
+    m.to_file = FILE_E; m.to_rank = RANK_5;
+    mu_assert("knight takes defended pawn", bitboard_see(b, &m) == -200);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_mate_and_stalemate() {
+    SearchOptions options;
+    SearchResult result;
+    Bitboard *b = bitboard_from_fen("7k/8/6Q1/8/8/8/8/6K1 b - - 0 1");
+
+    init_search_options(&options);
+    options.depth = 2;
+    engine_search(b, PIECE_COLOR_BLACK, &options, &result);
+    mu_assert("stalemate is a draw",
+        result.is_stalemate && !result.best_move.is_checkmate
+        && result.score == 0.0f);
+
+    bitboard_set_fen(b, "5Q1k/8/6K1/8/8/8/8/8 b - - 0 1");
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_BLACK, &options, &result);
+    mu_assert("checkmate is not a stalemate",
+        result.best_move.is_checkmate && !result.is_stalemate);
+
+    /* Qf8 mates, Qf7 stalemates */
+    bitboard_set_fen(b, "7k/8/6K1/8/8/8/8/5Q2 w - - 0 1");
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("mate in one found", result.best_move.to_file == FILE_F
+        && result.best_move.to_rank == RANK_8 && result.score > 0.0f);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
+static char *test_draws() {
+    SearchOptions options;
+    SearchResult result;
+    U64 history[3] = { 0ULL, 1ULL, 2ULL };
+    Bitboard *b = bitboard_from_fen("6k1/8/8/8/8/8/1R6/K7 w - - 4 2");
+
+    /* Kg8 goes back to a position of the game: a draw for the side behind */
+    history[0] = bitboard_key(b, PIECE_COLOR_WHITE);
+    bitboard_set_fen(b, "7k/8/8/8/8/8/1R6/K7 b - - 3 1");
+    init_search_options(&options);
+    options.depth = 3;
+    options.history = history;
+    options.history_length = 3;
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_BLACK, &options, &result);
+    mu_assert("repetition found", result.score == 0.0f
+        && result.best_move.to_file == FILE_G && result.best_move.to_rank == RANK_8);
+
+    options.history = NULL;
+    options.history_length = 0;
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_BLACK, &options, &result);
+    mu_assert("no repetition without the history", result.score < 0.0f);
+
+    /* any move but a capture or a pawn move ends the fifty moves */
+    bitboard_set_fen(b, "8/8/8/4k3/8/8/8/K6Q w - - 99 80");
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("fifty moves", result.score == 0.0f);
+
+    /* Qf8 mates on the hundredth halfmove */
+    bitboard_set_fen(b, "7k/8/6K1/8/8/8/8/5Q2 w - - 99 80");
+    engine_clear_hash();
+    engine_search(b, PIECE_COLOR_WHITE, &options, &result);
+    mu_assert("mate before the fifty moves", result.score > 0.0f
+        && result.best_move.to_file == FILE_F && result.best_move.to_rank == RANK_8);
+
+    destroy_bitboard(b);
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_get_best_move);
+    mu_run_test(test_ponder);
+    mu_run_test(test_multipv);
+    mu_run_test(test_threads);
+    mu_run_test(test_search_stats);
+    mu_run_test(test_eval_terms);
+    mu_run_test(test_see);
+    mu_run_test(test_mate_and_stalemate);
+    mu_run_test(test_draws);
     return 0;
 }
 
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minunit.h"
+
+#include "bitboard.h"
+#include "gamereader.h"
+
+/* - - - - - - - -  Tests for the game reader - - - - - - - - */
+int tests_run = 0;
+
+#define MAX_GAMES 4
+
+/* what the callbacks saw */
+typedef struct {
+    int n_starts;
+    int n_moves;
+    int n_illegal;
+    int n_ends;
+    GameInfo ended[MAX_GAMES];
+    Move last_move;
+} Events;
+
+static void _on_game_start(GameInfo *info, void *user_data)
+{
+    ((Events *)user_data)->n_starts++;
+}
+
+static int _on_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    Events *e = (Events *)user_data;
+    e->n_moves++;
+    memcpy(&(e->last_move), m, sizeof(Move));
+    return 1;
+}
+
+static int _on_illegal_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    ((Events *)user_data)->n_illegal++;
+    return 1;
+}
+
+static void _on_game_end(GameInfo *info, void *user_data)
+{
+    Events *e = (Events *)user_data;
+    if (e->n_ends < MAX_GAMES) memcpy(&(e->ended[e->n_ends]), info, sizeof(GameInfo));
+    e->n_ends++;
+}
+
+static GameReader *_create_reader(Events *e)
+{
+    GameReaderCallbacks callbacks = {
+        _on_game_start, _on_move, _on_illegal_move, _on_game_end, e
+    };
+    memset(e, 0, sizeof(Events));
+    return create_game_reader(&callbacks);
+}
+
+static const char *game =
+    "[Event \"Test\"]\n"
+    "[Result \"0-1\"]\n"
+    "[WhiteElo \"2450\"]\n"
+    "[BlackElo \"\"]\n"
+    "[ECO \"C20\"]\n"
+    "\n"
+    "1. e2-e4 e7-e5 2. g1-f3 b8-c6 3. f1-c4\n"
+    "g8-f6 4. f3-g5 d7-d5 0-1\n";
+
+static char *test_split_game() {
+    const char *split = strstr(game, "g8-f6");
+    Events e;
+    GameReader *r = _create_reader(&e);
+
+    mu_assert("First half parsed", game_reader_parse(r, game, split - game) == 1);
+    mu_assert("Game started", e.n_starts == 1 && e.n_ends == 0);
+    mu_assert("Moves of the first half", e.n_moves == 5);
+    mu_assert("Second half parsed", game_reader_parse(r, split, strlen(split)) == 1);
+    mu_assert("One game", e.n_starts == 1 && e.n_ends == 1);
+    mu_assert("Moves of both halves", e.n_moves == 8 && e.ended[0].n_moves == 8);
+    mu_assert("Last move", e.last_move.from_file == FILE_D
+        && e.last_move.from_rank == RANK_7 && e.last_move.to_rank == RANK_5);
+    mu_assert("No illegal move", !e.ended[0].illegal && !e.n_illegal);
+
+    destroy_game_reader(r);
+    return 0;
+}
+
+static char *test_tags() {
+    Events e;
+    GameReader *r = _create_reader(&e);
+
+    game_reader_parse(r, game, strlen(game));
+    mu_assert("Result tag", e.ended[0].result == GAME_RESULT_BLACK_WINS);
+    mu_assert("White Elo", e.ended[0].white_elo == 2450);
+    mu_assert("Unknown black Elo", e.ended[0].black_elo == 0);
+    mu_assert("ECO", !strcmp(e.ended[0].eco, "C20"));
+    mu_assert("First game", e.ended[0].index == 0);
+
+    destroy_game_reader(r);
+    return 0;
+}
+
+static char *test_illegal_move() {
+    const char *games =
+        "[Result \"1-0\"]\n"
+        "1. e2-e4 e7-e5 2. e1-e3 b8-c6 3. f1-c4 1-0\n"
+        "[Result \"1/2-1/2\"]\n"
+        "1. d2-d4 d7-d5 1/2-1/2\n";
+    Events e;
+    GameReader *r = _create_reader(&e);
+
+    mu_assert("Illegal game skipped", game_reader_parse(r, games, strlen(games)) == 1);
+    mu_assert("One illegal move", e.n_illegal == 1);
+    mu_assert("Both games ended", e.n_starts == 2 && e.n_ends == 2);
+    mu_assert("Game marked illegal", e.ended[0].illegal && e.ended[0].n_moves == 2);
+    mu_assert("Next game read", !e.ended[1].illegal && e.ended[1].n_moves == 2
+        && e.ended[1].result == GAME_RESULT_DRAW && e.ended[1].index == 1);
+    mu_assert("Moves before the illegal one and of the next game", e.n_moves == 4);
+
+    destroy_game_reader(r);
+    return 0;
+}
+
+static char *test_finish_without_result() {
+    const char *unfinished = "[Result \"*\"]\n1. e2-e4 c7-c5 2. g1-f3\n";
+    Events e;
+    GameReader *r = _create_reader(&e);
+
+    game_reader_parse(r, unfinished, strlen(unfinished));
+    mu_assert("Not ended without a result", e.n_starts == 1 && e.n_ends == 0);
+    game_reader_finish(r);
+    mu_assert("Ended by finish", e.n_ends == 1 && e.ended[0].n_moves == 3);
+    mu_assert("Unknown result", e.ended[0].result == GAME_RESULT_UNKNOWN);
+    game_reader_finish(r);
+    mu_assert("Nothing more to end", e.n_ends == 1);
+
+    destroy_game_reader(r);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_split_game);
+    mu_run_test(test_tags);
+    mu_run_test(test_illegal_move);
+    mu_run_test(test_finish_without_result);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char *result = all_tests();
+    if (result != 0) {
+        printf("not ok - %s\n", result);
+    }
+    else {
+        printf("\\o/ All game reader tests passed!\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
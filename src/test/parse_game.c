@@ -1,258 +1,276 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #include "bitboard.h"
+#include "gamereader.h"
 
 /* - - - - - SOME DECLARATIONS - - - - - - */
 
 int verbose = 0;
 
-PieceType type_mapper(void *el)
-{
-    char * x = (char*) el;
-    switch (*x) {
-        case 'r': return BLACK_ROOK;
-        case 'n': return BLACK_KNIGHT;
-        case 'b': return BLACK_BISHOP;
-        case 'q': return BLACK_QUEEN;
-        case 'k': return BLACK_KING;
-        case 'p': return BLACK_PAWN;
-        case 'R': return WHITE_ROOK;
-        case 'N': return WHITE_KNIGHT;
-        case 'B': return WHITE_BISHOP;
-        case 'Q': return WHITE_QUEEN;
-        case 'K': return WHITE_KING;
-        case 'P': return WHITE_PAWN;
-    }
-    return PIECE_NONE;
-}
+/* - - - - - - PARSER STATE  - - - - - - */
 
-Bitboard *create_default_chessboard() {
-	char *chessboard =
-        "rnbqkbnr"
-        "pppppppp"
-        "........"
-        "........"
-        "........"
-        "........"
-        "PPPPPPPP"
-        "RNBQKBNR";
-	Bitboard *b = create_bitboard((void *)chessboard, sizeof(char), &type_mapper, 0);
-    return b;
-}
+typedef struct {
+    /* skip games with an illegal move rather than stopping */
+    int skip_illegal_games;
 
-typedef enum {
-    READ_MOVE_NUMBER,
-    READ_FIRST_FILE,
-    READ_FIRST_RANK,
-    READ_SECOND_FILE,
-    READ_SECOND_RANK,
-    READ_THIRD_FILE,
-    READ_THIRD_RANK,
-    READ_FOURTH_FILE,
-    READ_FOURTH_RANK,
-    STATE_COUNT 
-} ParserLookFor;
-
-/* - - - - - - GLOBAL PARSER STATE  - - - - - - */ 
-Bitboard *chessboard = 0;
-ParserLookFor state = READ_MOVE_NUMBER;
-
-/* - - - - - - EVENTS CALLED FROM PARSER - - - - - - */ 
-
-unsigned long long ingame_move_counter;
-unsigned long long games_counter = 0;
-unsigned long long move_counter = 0;
-void new_game() 
+    unsigned long long games_counter;
+    unsigned long long move_counter;
+
+    /* first illegal move found, counting games from 1 */
+    unsigned long long illegal_games_counter;
+    unsigned long long illegal_game;
+    unsigned long long illegal_move_number;
+    Move illegal_move;
+} ParserState;
+
+/* - - - - - - EVENTS CALLED FROM READER - - - - - - */
+
+void new_game(GameInfo *info, void *user_data)
 {
-    ingame_move_counter = 0;
-    if (chessboard) {
-        destroy_bitboard(chessboard);
-    }
-    chessboard = create_default_chessboard();
-    if (verbose) { 
+    if (verbose) {
         printf("Created Chessboard\n");
-        print_chessboard(chessboard);
     }
 }
 
-int do_move(Move *m)
+int do_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
 {
-    ingame_move_counter++;
+    ParserState *ps = (ParserState *)user_data;
     if (verbose) {
-        printf("[%llu] Move %c%c - %c%c ", 
-           move_counter + ingame_move_counter,
+        printf("[%llu] Move %c%c - %c%c OK\n",
+           ps->move_counter + info->n_moves,
            m->from_file + 97, m->from_rank + 49,
            m->to_file + 97, m->to_rank + 49
         );
+        print_chessboard_move(b, m);
     }
-    if (is_legal_move(chessboard, m)) {
-        if (verbose) { printf("OK\n"); }
-        bitboard_do_move(chessboard, m);
-        if (verbose) { print_chessboard_move(chessboard, m); }
-        return 1;
+    return 1;
+}
+
+int illegal_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    ParserState *ps = (ParserState *)user_data;
+
+    if (!ps->illegal_game) {
+        ps->illegal_game = ps->games_counter + ps->illegal_games_counter + 1;
+        ps->illegal_move_number = info->n_moves + 1;
+        memcpy(&(ps->illegal_move), m, sizeof(Move));
     }
-    printf("!!! NOT LEGAL !!!\n");
-    print_chessboard_move(chessboard, m);
-    printf("The current chessboard looks like:\n");
-    print_chessboard(chessboard);
-    // print_bitboard(chessboard);
-    return 0;
+    ps->illegal_games_counter++;
+
+    if (!ps->skip_illegal_games) {
+        printf("!!! NOT LEGAL !!! (game %llu, move %llu)\n",
+            ps->illegal_game, ps->illegal_move_number);
+        print_chessboard_move(b, m);
+        printf("The current chessboard looks like:\n");
+        print_chessboard(b);
+    }
+    return ps->skip_illegal_games;
 }
 
-void end_game()
+void end_game(GameInfo *info, void *user_data)
 {
-    if (ingame_move_counter) {
-        move_counter += ingame_move_counter;
-        games_counter++;
+    ParserState *ps = (ParserState *)user_data;
+    if (!info->illegal && info->n_moves) {
+        ps->move_counter += info->n_moves;
+        ps->games_counter++;
     }
 
     if (verbose) { printf("--- end of game ---\n"); }
-    destroy_bitboard(chessboard);
-    chessboard = NULL;
 }
 
+/*
+ * Validates the games in data with a reader of its own. Returns 0 at the
+ * first illegal move, unless ps->skip_illegal_games is set: then the rest of
+ * the game is skipped.
+ */
+int parse_games(ParserState *ps, const char *data, size_t size)
+{
+    GameReaderCallbacks callbacks = {
+        new_game, do_move, illegal_move, end_game, ps
+    };
+    GameReader *reader = create_game_reader(&callbacks);
+    int result = game_reader_parse(reader, data, size);
+
+    if (result == 1) game_reader_finish(reader);
+    destroy_game_reader(reader);
+    return result;
+}
+
+/* - - - - - - PARALLEL VALIDATION - - - - - - */
+
+#define CHUNKS_PER_WORKER 8
+
+typedef struct {
+    const char *data;
+    size_t size;
+    ParserState state;
+} Chunk;
 
-/* - - - - - PARSER & HELPERS - - - - - - - */
+typedef struct {
+    Chunk *chunks;
+    int n_chunks;
+    volatile int next_chunk;
+} ChunkQueue;
 
-int is_valid_char(char ch)
+/* the chunk boundary is moved forward to the next game */
+const char *next_game_start(const char *p, const char *end)
 {
-    switch (state){
-        case READ_MOVE_NUMBER:
-            if (ch == '-' || ch == '*') { 
-                /* HALT CONDITION */
-                end_game(); 
-                new_game();
-                state = READ_MOVE_NUMBER; 
-                return 0; 
-            }
-            switch (ch) {
-                case '.': return 1;
-                default : return 0;
-            }
-            break;
-        case READ_FIRST_FILE:
-        case READ_THIRD_FILE:
-            if (ch == '-' || ch == '*') { 
-                /* HALT CONDITION */
-                end_game(); 
-                new_game();
-                state = READ_MOVE_NUMBER; 
-                return 0; 
-            }
-        case READ_FOURTH_FILE:
-        case READ_SECOND_FILE:
-            if (ch >= 0x61 && ch <= 0x68) return 1; /* a - h */
-            return 0;
-
-        case READ_FIRST_RANK:
-        case READ_SECOND_RANK:
-        case READ_THIRD_RANK:
-        case READ_FOURTH_RANK:
-            if (ch >= 0x31 && ch <= 0x38) return 1;
-            return 0;
+    while (p < end) {
+        p = memchr(p, '\n', end - p);
+        if (!p) return end;
+        p++;
+        if (end - p >= 6 && !memcmp(p, "[Event", 6)) return p;
     }
+    return end;
+}
 
-    return 0;
+int split_chunks(const char *data, size_t size, Chunk *chunks, int n_chunks)
+{
+    const char *end = data + size;
+    const char *start = data;
+    int i, n = 0;
+
+    for (i=1; i<=n_chunks && start < end; i++) {
+        const char *stop = (i == n_chunks)
+            ? end
+            : next_game_start(data + size / n_chunks * i, end);
+        if (stop <= start) continue;
+        chunks[n].data = start;
+        chunks[n].size = stop - start;
+        n++;
+        start = stop;
+    }
+    return n;
 }
 
-PieceType maybe_promote_piece(char ch, ParserLookFor state) {
-    if (state == READ_SECOND_RANK) {
-        switch (ch) {
-            case 'Q': return WHITE_QUEEN;
-            case 'R': return WHITE_ROOK;
-            case 'N': return WHITE_KNIGHT;
-            case 'B': return WHITE_BISHOP;
-        }
+void *validation_worker(void *arg)
+{
+    ChunkQueue *q = (ChunkQueue *)arg;
+    int i;
+
+    while ((i = __sync_fetch_and_add(&(q->next_chunk), 1)) < q->n_chunks) {
+        ParserState *ps = &(q->chunks[i].state);
+        memset(ps, 0, sizeof(ParserState));
+        ps->skip_illegal_games = 1;
+        parse_games(ps, q->chunks[i].data, q->chunks[i].size);
+    }
+
+    return NULL;
+}
+
+/* merges the chunks in order into ps, game indexes become global */
+void parse_games_parallel(ParserState *ps, const char *data, size_t size,
+    int n_workers)
+{
+    ChunkQueue q;
+    pthread_t *workers = malloc(n_workers * sizeof(pthread_t));
+    int i;
+
+    q.chunks = malloc(n_workers * CHUNKS_PER_WORKER * sizeof(Chunk));
+    q.n_chunks = split_chunks(data, size, q.chunks, n_workers * CHUNKS_PER_WORKER);
+    q.next_chunk = 0;
+
+    for (i=0; i<n_workers; i++) {
+        pthread_create(&(workers[i]), NULL, validation_worker, &q);
     }
-    else {
-        switch (ch) {
-            case 'Q': return BLACK_QUEEN;
-            case 'R': return BLACK_ROOK;
-            case 'N': return BLACK_KNIGHT;
-            case 'B': return BLACK_BISHOP;
+    for (i=0; i<n_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (i=0; i<q.n_chunks; i++) {
+        ParserState *chunk = &(q.chunks[i].state);
+        unsigned long long games_before = ps->games_counter + ps->illegal_games_counter;
+
+        if (chunk->illegal_game && !ps->illegal_game) {
+            ps->illegal_game = games_before + chunk->illegal_game;
+            ps->illegal_move_number = chunk->illegal_move_number;
+            memcpy(&(ps->illegal_move), &(chunk->illegal_move), sizeof(Move));
         }
+        ps->games_counter += chunk->games_counter;
+        ps->move_counter += chunk->move_counter;
+        ps->illegal_games_counter += chunk->illegal_games_counter;
     }
-    return PIECE_NONE;
-}
 
-int main(int argc, char **argv) {
-    /* will fill up the move as we parse it */
-    Move move = {0};
+    free(q.chunks);
+    free(workers);
+}
 
-    /* start from a default chessboard */
-    Bitboard *chessboard = create_default_chessboard();
+double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
 
-    /* the game to load */
+/* usage: parse_games [-j <workers>] [file], -j 0 uses all cores */
+int main(int argc, char **argv) {
+    /* the games to load */
     const char *filename = "../games/all_games.whalg";
+    int n_workers = 1;
+    ParserState ps;
+    struct stat st;
+    struct timespec start;
+    const char *data;
+    double seconds;
+    int fd, i;
 
-    /* expect the first move for a new game */
-    new_game();
-
-    FILE *file = fopen(filename, "r");
-    if (file) {
-        /* bunch of variables used by the parser */
-        char line [128];
-        char ch;
-        int all_legal_moves_so_far = 1;
-        unsigned int line_idx;
-        ParserLookFor old_state;
-
-
-        while (all_legal_moves_so_far 
-               && fgets(line, sizeof(line), file)) {
-
-            /* skip unwanted lines */
-            if (line[0] != '[' && line[0] != ' ') {
-
-                /* inspect a line */
-                if (verbose) { printf("Parsing: %s", line); }
-                line_idx = 0;
-
-                while (all_legal_moves_so_far 
-                       && (ch = line[line_idx++])) {
-
-                    old_state = state;
-                    if (is_valid_char(ch)) {
-                        if (old_state != state) continue;
-                        switch (state) {
-                            case READ_MOVE_NUMBER:
-                                break;
-                            case READ_FIRST_FILE: 
-                            case READ_THIRD_FILE:
-                                move.from_file = ch - 97;
-                                break;
-                            case READ_FIRST_RANK: 
-                            case READ_THIRD_RANK:
-                                move.from_rank = ch - 49;
-                                break;
-                            case READ_SECOND_FILE:
-                            case READ_FOURTH_FILE:
-                                move.to_file = ch - 97;
-                                break;
-                            case READ_SECOND_RANK:
-                            case READ_FOURTH_RANK:
-                                move.to_rank = ch - 49;
-                                
-                                /* before making the move, check if we are going to promote */
-                                move.promote_to = maybe_promote_piece(line[line_idx], state);
-
-                                all_legal_moves_so_far = do_move(&move);
-                                break;
-                        }
-                        state++;
-                        state = state >= STATE_COUNT ? READ_MOVE_NUMBER : state;
-                    }
-                }
-            }
+    for (i=1; i<argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            n_workers = atoi(argv[++i]);
+            if (n_workers <= 0) n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else {
+            filename = argv[i];
         }
-        fclose (file);
-        end_game();
     }
-    else {
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
         perror(filename);
+        return 1;
+    }
+
+    memset(&ps, 0, sizeof(ParserState));
+    if (st.st_size) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror(filename);
+            close(fd);
+            return 1;
+        }
+        madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (n_workers > 1) {
+            parse_games_parallel(&ps, data, st.st_size, n_workers);
+        }
+        else {
+            parse_games(&ps, data, st.st_size);
+        }
+        seconds = elapsed_seconds(&start);
+
+        munmap((void *)data, st.st_size);
+
+        printf("Parsed %.1f MB in %.3f s with %d worker(s) (%.1f MB/s, %.0f moves/s).\n",
+            st.st_size / 1e6, seconds, n_workers,
+            seconds > 0 ? st.st_size / 1e6 / seconds : 0.0,
+            seconds > 0 ? ps.move_counter / seconds : 0.0);
     }
-    printf("Validated %llu total moves in %llu games.\n", move_counter, games_counter);
+    close(fd);
 
+    printf("Validated %llu total moves in %llu games.\n", ps.move_counter, ps.games_counter);
+    if (ps.illegal_game) {
+        printf("%llu game(s) with illegal moves, the first one is game %llu at move %llu: ",
+            ps.illegal_games_counter, ps.illegal_game, ps.illegal_move_number);
+        print_move_fmt(&(ps.illegal_move), "%c%c-%c%c\n");
+    }
     return 0;
 }
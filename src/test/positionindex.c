@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "minunit.h"
+
+#include "bitboard.h"
+#include "gamepack.h"
+#include "positionindex.h"
+
+/* - - - - - - -  Tests for the position index - - - - - - - - */
+int tests_run = 0;
+
+static const char *games[] = {
+    "g1f3 g8f6 g2g3 d7d5 f1g2 c7c6",
+    "g2g3 g8f6 g1f3 d7d5",
+    "e2e4 e7e5 g1f3 b8c6",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4",
+    "d2d3 d7d5 e2e4 d5d4 c2c4 d4c3",
+};
+#define N_GAMES (int)(sizeof(games) / sizeof(games[0]))
+
+static GamePack *pack;
+static PositionIndex *idx;
+
+/* packs the games into f */
+static int _write_pack(FILE *f)
+{
+    GamePackWriter *w = create_game_pack_writer(f);
+    uint16_t moves[64];
+    GameInfo info;
+    Bitboard *b;
+    Move m;
+    char line[256], *token;
+    int i;
+
+    for (i=0; i<N_GAMES; i++) {
+        memset(&info, 0, sizeof(GameInfo));
+        info.index = i;
+        b = bitboard_from_fen(FEN_INITIAL_POSITION);
+        strcpy(line, games[i]);
+        for (token=strtok(line, " "); token; token=strtok(NULL, " ")) {
+            if (!move_from_string(b, token, &m) || !is_legal_move(b, &m)) return 0;
+            moves[info.n_moves++] = game_pack_encode_move(&m);
+            bitboard_do_move(b, &m);
+        }
+        destroy_bitboard(b);
+        game_pack_write_game(w, &info, moves, info.n_moves);
+    }
+    return close_game_pack_writer(w);
+}
+
+/* packs the games, then indexes them, both in temporary files */
+static int _build_index()
+{
+    FILE *pack_file = tmpfile(), *index_file = tmpfile();
+
+    if (!_write_pack(pack_file)) return 0;
+    pack = open_game_pack(fileno(pack_file));
+    if (!pack || build_position_index(pack, index_file, 1) < 0) return 0;
+    idx = open_position_index(fileno(index_file));
+    return idx != NULL;
+}
+
+/* number of games reaching the position of the FEN after the moves */
+static unsigned long long _find(const char *fen, const char *moves)
+{
+    const PositionIndexEntry *first;
+    Bitboard *b = bitboard_from_fen(fen);
+    char line[256], *token;
+    unsigned long long n;
+    Move m;
+
+    strcpy(line, moves);
+    for (token=strtok(line, " "); token; token=strtok(NULL, " ")) {
+        move_from_string(b, token, &m);
+        bitboard_do_move(b, &m);
+    }
+    n = position_index_find(idx, bitboard_key(b, b->turn), &first);
+    destroy_bitboard(b);
+    return n;
+}
+
+static char *test_build() {
+    mu_assert("Games packed and indexed", _build_index());
+    mu_assert("One entry per move", position_index_count(idx) == 26);
+    return 0;
+}
+
+static char *test_find_by_moves() {
+    mu_assert("Found by moves", _find(FEN_INITIAL_POSITION, "g1f3 g8f6 g2g3") == 2);
+    mu_assert("Found by moves", _find(FEN_INITIAL_POSITION, "e2e4") == 2);
+    mu_assert("Found by moves", _find(FEN_INITIAL_POSITION, "d2d3") == 1);
+    mu_assert("Found by moves",
+        _find(FEN_INITIAL_POSITION, "d2d3 d7d5 e2e4 d5d4 c2c4") == 1);
+    mu_assert("Not found by moves", _find(FEN_INITIAL_POSITION, "a2a3") == 0);
+    return 0;
+}
+
+static char *test_find_by_fen() {
+    mu_assert("Same games by FEN as by moves",
+        _find("rnbqkb1r/pppppppp/5n2/8/8/5NP1/PPPPPP1P/RNBQKB1R b KQkq - 0 2", "") == 2);
+    mu_assert("Same games by FEN with no en-passant square",
+        _find("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1", "") == 2);
+    mu_assert("Same games by FEN with an en-passant square nobody can take",
+        _find("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", "") == 2);
+    mu_assert("Same games by FEN after a single step",
+        _find("rnbqkbnr/pppppppp/8/8/8/3P4/PPP1PPPP/RNBQKBNR b KQkq - 0 1", "") == 1);
+    mu_assert("Same games by FEN with an en-passant square",
+        _find("rnbqkbnr/ppp1pppp/8/8/2PpP3/3P4/PP3PPP/RNBQKBNR b KQkq c3 0 3", "") == 1);
+    return 0;
+}
+
+static char *test_corrupted_pack() {
+    FILE *pack_file = tmpfile(), *index_file = tmpfile();
+    GamePackHeader header;
+    uint64_t offsets[N_GAMES];
+    uint32_t n_moves = 0xFFFF;
+    uint16_t move;
+    GamePack *corrupted;
+    Move m;
+
+    mu_assert("Games packed", _write_pack(pack_file));
+    pread(fileno(pack_file), &header, sizeof(header), 0);
+    pread(fileno(pack_file), offsets, sizeof(offsets), header.index_offset);
+
+    /* more moves than the file has, a game past the index, a4-a5 */
+    pwrite(fileno(pack_file), &n_moves, sizeof(n_moves), offsets[0]);
+    offsets[2] = header.index_offset + 8;
+    pwrite(fileno(pack_file), offsets, sizeof(offsets), header.index_offset);
+    init_move(&m);
+    m.from_file = FILE_A;
+    m.from_rank = RANK_4;
+    m.to_file = FILE_A;
+    m.to_rank = RANK_5;
+    move = game_pack_encode_move(&m);
+    pwrite(fileno(pack_file), &move, sizeof(move), offsets[1] + sizeof(PackedGame));
+
+    corrupted = open_game_pack(fileno(pack_file));
+    mu_assert("Corrupted pack opened", corrupted != NULL);
+    mu_assert("Game with too many moves rejected", !game_pack_get(corrupted, 0));
+    mu_assert("Game past the index rejected", !game_pack_get(corrupted, 2));
+    mu_assert("Other games kept", game_pack_get(corrupted, 3) != NULL);
+    mu_assert("Moves of nothing skipped",
+        build_position_index(corrupted, index_file, 1) == 12);
+    close_game_pack(corrupted);
+    fclose(pack_file);
+    fclose(index_file);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_build);
+    mu_run_test(test_find_by_moves);
+    mu_run_test(test_find_by_fen);
+    mu_run_test(test_corrupted_pack);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char *result = all_tests();
+    if (result != 0) {
+        printf("not ok - %s\n", result);
+    }
+    else {
+        printf("\\o/ All position index tests passed!\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+
+    if (idx) close_position_index(idx);
+    if (pack) close_game_pack(pack);
+    return result != 0;
+}
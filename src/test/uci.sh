@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Scripted UCI sessions: stop and ponderhit sent right after go must end the
+# search, even when they are read before the search has started, and isready
+# must be answered after the commands sent before it.
+#
+# usage: src/test/uci.sh [./build/smoengine-uci]
+
+ENGINE=${1:-./build/smoengine-uci}
+FAILED=0
+
+# session <name> <commands...>: fails if no bestmove comes within 10 seconds
+session()
+{
+    name=$1
+    shift
+    output=$(printf '%s\n' "$@" | timeout 10 "$ENGINE")
+    if echo "$output" | grep -q '^bestmove '; then
+        echo "$name: ok"
+    else
+        echo "$name: FAILED, no bestmove"
+        FAILED=1
+    fi
+}
+
+session "go infinite, stop" "position startpos" "go infinite" "stop"
+session "go ponder, ponderhit" "position startpos moves e2e4" "go ponder depth 3" "ponderhit"
+session "go ponder, stop" "position startpos moves e2e4" "go ponder depth 3" "stop"
+
+# readyok must come after the answer to uci
+output=$(printf '%s\n' "uci" "setoption name Hash value 16" "isready" | timeout 10 "$ENGINE")
+if echo "$output" | tail -n 1 | grep -q '^readyok$'; then
+    echo "isready in order: ok"
+else
+    echo "isready in order: FAILED, readyok before uciok"
+    FAILED=1
+fi
+
+# during a search, readyok comes right away
+output=$(printf '%s\n' "go infinite" "isready" "stop" | timeout 10 "$ENGINE")
+if echo "$output" | grep -v '^info' | head -n 1 | grep -q '^readyok$'; then
+    echo "isready while searching: ok"
+else
+    echo "isready while searching: FAILED"
+    FAILED=1
+fi
+
+if [ $FAILED -ne 0 ]; then
+    echo "Some UCI tests failed"
+    exit 1
+fi
+printf '%s\n' '\o/ All UCI tests passed!'
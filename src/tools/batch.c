@@ -0,0 +1,325 @@
+/*
+ * Bulk evaluation of positions: FEN lines are read from stdin, and for each
+ * one a line is written to stdout, in the same order:
+ *
+ *   <fen> TAB <static eval> TAB <search score> TAB <best move>
+ *
+ * or "<fen> TAB error" if the FEN is malformed. Scores are from the point of
+ * view of the side to move. With -d 0 only the static eval is computed.
+ *
+ * usage: smoengine-batch [-d <depth>] [-n <nodes>] [-j <workers>] [-H <hash MB>]
+ *
+ * stdin is read in large blocks, cut into jobs of whole lines. Workers keep a
+ * board and a transposition table of their own (cleared for each position,
+ * and ties are broken with a fixed seed, so results do not depend on
+ * scheduling). Outputs go through a reorder
+ * window: at most BATCH_WINDOW jobs are in flight, so memory stays bounded
+ * however far a slow job lags behind.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bitboard.h"
+#include "engine.h"
+
+#define BATCH_READ_SIZE (1 << 20)
+#define BATCH_JOB_LINES 256
+#define BATCH_WINDOW 256
+#define BATCH_DEFAULT_DEPTH 3
+#define BATCH_DEFAULT_HASH_MB 1
+#define BATCH_OUTPUT_LINE_SIZE (FEN_MAX_LENGTH + 64)
+
+typedef enum {
+    JOB_FREE,
+    JOB_READY,      /* waiting for a worker */
+    JOB_RUNNING,
+    JOB_DONE        /* waiting for the writer */
+} JobState;
+
+typedef struct {
+    JobState state;
+    unsigned long long seq;
+    char *input;                /* whole lines, NUL terminated */
+    int n_lines;
+    char *output;
+    size_t output_len;
+} Job;
+
+typedef struct {
+    Job jobs[BATCH_WINDOW];     /* job seq is in jobs[seq % BATCH_WINDOW] */
+    unsigned long long n_jobs;  /* created so far */
+    unsigned long long next_job;    /* next to run */
+    unsigned long long n_written;
+    int eof;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    pthread_cond_t slot_free;
+
+    SearchOptions options;
+    int depth;
+    unsigned int hash_mb;
+    unsigned long long n_positions;
+} Batch;
+
+/* - - - - - - - - - - WORKERS - - - - - - - - - - */
+
+size_t evaluate_line(Batch *batch, Bitboard *b, TranspositionTable *tt,
+    char *line, char *dest)
+{
+    SearchOptions options = batch->options;
+    SearchResult result;
+    char move[6];
+    float eval;
+
+    if (!bitboard_set_fen(b, line)) {
+        return sprintf(dest, "%s\terror\n", line);
+    }
+
+    eval = evaluate_bitboard(b, b->turn);
+    if (!batch->depth) {
+        return sprintf(dest, "%s\t%.2f\n", line, eval);
+    }
+
+    clear_transposition_table(tt);
+    options.tt = tt;
+    engine_search(b, b->turn, &options, &result);
+    if (result.best_move.is_checkmate || result.is_stalemate) strcpy(move, "none");
+    else move_to_string(&(result.best_move), move);
+
+    return sprintf(dest, "%s\t%.2f\t%.2f\t%s\n", line, eval, result.score, move);
+}
+
+void run_job(Batch *batch, Job *job, Bitboard *b, TranspositionTable *tt)
+{
+    char *line = job->input, *eol;
+    size_t size = (size_t)job->n_lines * BATCH_OUTPUT_LINE_SIZE;
+
+    job->output = malloc(size);
+    job->output_len = 0;
+    for (; *line; line = eol + 1) {
+        eol = strchr(line, '\n');
+        *eol = '\0';
+        if (eol > line && eol[-1] == '\r') eol[-1] = '\0';
+
+        /* FENs longer than that are malformed anyway */
+        if (eol - line >= FEN_MAX_LENGTH) line[FEN_MAX_LENGTH - 1] = '\0';
+        job->output_len += evaluate_line(batch, b, tt, line,
+            job->output + job->output_len);
+    }
+}
+
+void *batch_worker(void *arg)
+{
+    Batch *batch = (Batch *)arg;
+    Bitboard *b = create_blank_bitboard();
+    TranspositionTable *tt = create_transposition_table(batch->hash_mb);
+    Job *job;
+
+    pthread_mutex_lock(&(batch->lock));
+    for (;;) {
+        while (batch->next_job == batch->n_jobs && !batch->eof) {
+            pthread_cond_wait(&(batch->job_ready), &(batch->lock));
+        }
+        if (batch->next_job == batch->n_jobs) break;
+
+        job = &(batch->jobs[batch->next_job++ % BATCH_WINDOW]);
+        job->state = JOB_RUNNING;
+        pthread_mutex_unlock(&(batch->lock));
+
+        run_job(batch, job, b, tt);
+
+        pthread_mutex_lock(&(batch->lock));
+        job->state = JOB_DONE;
+        pthread_cond_signal(&(batch->job_done));
+    }
+    pthread_mutex_unlock(&(batch->lock));
+
+    destroy_transposition_table(tt);
+    destroy_bitboard(b);
+    return NULL;
+}
+
+/* - - - - - - - - - - WRITER - - - - - - - - - - */
+
+void *batch_writer(void *arg)
+{
+    Batch *batch = (Batch *)arg;
+    Job *job;
+
+    pthread_mutex_lock(&(batch->lock));
+    for (;;) {
+        job = &(batch->jobs[batch->n_written % BATCH_WINDOW]);
+        while (!(batch->n_written < batch->n_jobs && job->state == JOB_DONE)
+               && !(batch->eof && batch->n_written == batch->n_jobs)) {
+            pthread_cond_wait(&(batch->job_done), &(batch->lock));
+        }
+        if (batch->n_written == batch->n_jobs) break;
+        pthread_mutex_unlock(&(batch->lock));
+
+        fwrite(job->output, 1, job->output_len, stdout);
+        free(job->output);
+        free(job->input);
+
+        pthread_mutex_lock(&(batch->lock));
+        job->state = JOB_FREE;
+        batch->n_written++;
+        pthread_cond_signal(&(batch->slot_free));
+    }
+    pthread_mutex_unlock(&(batch->lock));
+    fflush(stdout);
+    return NULL;
+}
+
+/* - - - - - - - - - - READER - - - - - - - - - - */
+
+/* queues lines [start, end) as one job, waiting for a free slot */
+void submit_job(Batch *batch, const char *start, size_t size, int n_lines)
+{
+    Job *job;
+
+    pthread_mutex_lock(&(batch->lock));
+    while (batch->n_jobs - batch->n_written >= BATCH_WINDOW) {
+        pthread_cond_wait(&(batch->slot_free), &(batch->lock));
+    }
+    job = &(batch->jobs[batch->n_jobs % BATCH_WINDOW]);
+    pthread_mutex_unlock(&(batch->lock));
+
+    job->seq = batch->n_jobs;
+    job->input = malloc(size + 1);
+    memcpy(job->input, start, size);
+    job->input[size] = '\0';
+    job->n_lines = n_lines;
+    batch->n_positions += n_lines;
+
+    pthread_mutex_lock(&(batch->lock));
+    job->state = JOB_READY;
+    batch->n_jobs++;
+    pthread_cond_signal(&(batch->job_ready));
+    pthread_mutex_unlock(&(batch->lock));
+}
+
+/* cuts buffer into jobs of whole lines, returns the bytes left over */
+size_t submit_lines(Batch *batch, char *buffer, size_t size, int flush)
+{
+    char *start = buffer, *p = buffer, *end = buffer + size;
+    int n_lines = 0;
+
+    while (p < end) {
+        char *eol = memchr(p, '\n', end - p);
+        if (!eol) break;
+        p = eol + 1;
+        if (++n_lines == BATCH_JOB_LINES) {
+            submit_job(batch, start, p - start, n_lines);
+            start = p;
+            n_lines = 0;
+        }
+    }
+    if (n_lines) {
+        submit_job(batch, start, p - start, n_lines);
+        start = p;
+    }
+    if (flush && start < end) {
+        /* last line without newline */
+        char *last = malloc(end - start + 1);
+        memcpy(last, start, end - start);
+        last[end - start] = '\n';
+        submit_job(batch, last, end - start + 1, 1);
+        free(last);
+        start = end;
+    }
+    return end - start;
+}
+
+double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int n_workers = 1, i;
+    pthread_t *workers, writer;
+    struct timespec start;
+    size_t used = 0, n_read;
+    char *buffer;
+    double seconds;
+    Batch batch;
+
+    memset(&batch, 0, sizeof(Batch));
+    init_search_options(&(batch.options));
+    batch.depth = BATCH_DEFAULT_DEPTH;
+    batch.hash_mb = BATCH_DEFAULT_HASH_MB;
+
+    for (i=1; i<argc; i++) {
+        int has_value = i + 1 < argc;
+        if (!has_value) break;
+        if (!strcmp(argv[i], "-d")) batch.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n")) batch.options.nodes = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-H")) batch.hash_mb = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j")) {
+            n_workers = atoi(argv[++i]);
+            if (n_workers <= 0) n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else break;
+    }
+    if (i < argc) {
+        fprintf(stderr, "usage: %s [-d <depth>] [-n <nodes>] [-j <workers>] "
+            "[-H <hash MB>] < fens > results\n", argv[0]);
+        return 1;
+    }
+    batch.options.depth = batch.depth;
+    batch.options.seed = 1;
+
+    pthread_mutex_init(&(batch.lock), NULL);
+    pthread_cond_init(&(batch.job_ready), NULL);
+    pthread_cond_init(&(batch.job_done), NULL);
+    pthread_cond_init(&(batch.slot_free), NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    workers = malloc(n_workers * sizeof(pthread_t));
+    for (i=0; i<n_workers; i++) {
+        pthread_create(&(workers[i]), NULL, batch_worker, &batch);
+    }
+    pthread_create(&writer, NULL, batch_writer, &batch);
+
+    buffer = malloc(BATCH_READ_SIZE);
+    while ((n_read = fread(buffer + used, 1, BATCH_READ_SIZE - used, stdin)) > 0) {
+        size_t left = submit_lines(&batch, buffer, used + n_read,
+            used + n_read == BATCH_READ_SIZE && !memchr(buffer, '\n', BATCH_READ_SIZE));
+        memmove(buffer, buffer + used + n_read - left, left);
+        used = left;
+    }
+    submit_lines(&batch, buffer, used, 1);
+    free(buffer);
+
+    pthread_mutex_lock(&(batch.lock));
+    batch.eof = 1;
+    pthread_cond_broadcast(&(batch.job_ready));
+    pthread_cond_broadcast(&(batch.job_done));
+    pthread_mutex_unlock(&(batch.lock));
+
+    for (i=0; i<n_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_join(writer, NULL);
+    seconds = elapsed_seconds(&start);
+
+    fprintf(stderr, "%llu positions in %.3f s with %d worker(s), %.0f positions/s.\n",
+        batch.n_positions, seconds, n_workers,
+        seconds > 0 ? batch.n_positions / seconds : 0.0);
+
+    free(workers);
+    pthread_mutex_destroy(&(batch.lock));
+    pthread_cond_destroy(&(batch.job_ready));
+    pthread_cond_destroy(&(batch.job_done));
+    pthread_cond_destroy(&(batch.slot_free));
+    return 0;
+}
@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitboard.h"
+#include "attacks.h"
+#include "engine.h"
+#include "gamereader.h"
+
+/*
+ * Microbenchmarks of the bitboard primitives, over positions sampled from a
+ * game file.
+ *
+ * usage: bench [-n <positions>] [-w <warmup>] [-r <repetitions>]
+ *              [-b <name>] [games.whalg]
+ *
+ * Positions are taken every BENCH_PLY_STEP plies of every game, then n of
+ * them (default 1000) are picked evenly spaced, so the set only depends on
+ * the file. A sample runs a benchmark over the whole set, as many times as
+ * needed to last BENCH_MIN_SAMPLE_NS. The first warmup samples are dropped,
+ * the next repetitions ones are reported, in ns per call: min, median, p90,
+ * p99, max and mean. Results go to stdout as JSON, and as a table to stderr.
+ *
+ * -b only runs the benchmarks whose name contains the given string.
+ */
+
+#define BENCH_DEFAULT_GAMES "games/Adams.whalg"
+#define BENCH_DEFAULT_POSITIONS 1000
+#define BENCH_DEFAULT_WARMUP 5
+#define BENCH_DEFAULT_REPETITIONS 30
+#define BENCH_PLY_STEP 10
+#define BENCH_MIN_SAMPLE_NS 1000000LL
+#define MAX_MOVES_PER_POSITION 256
+
+/* the pieces, grouped by the function computing their attacks */
+typedef enum {
+    BENCH_ROOKS,
+    BENCH_BISHOPS,
+    BENCH_QUEENS,
+    BENCH_KNIGHTS,
+    BENCH_WHITE_KINGS,
+    BENCH_BLACK_KINGS,
+    BENCH_WHITE_PAWNS,
+    BENCH_BLACK_PAWNS,
+    BENCH_N_KINDS
+} BenchKind;
+
+typedef struct {
+    Bitboard *b;
+    FileType file;
+    RankType rank;
+    U64 bit;
+} BenchPiece;
+
+typedef struct {
+    BenchPiece *pieces;
+    int n;
+} BenchPieceList;
+
+typedef struct {
+    Bitboard *b;
+    Move m;
+} BenchMove;
+
+typedef struct {
+    Bitboard *positions;
+    int n_positions;
+
+    BenchPieceList kinds[BENCH_N_KINDS];
+    BenchPieceList all_pieces;
+    BenchPieceList movers;          /* pieces of the side to move */
+
+    BenchMove *moves;               /* moves of the side to move */
+    int n_moves;
+
+    U64 *masks;                     /* bitboards of each piece type */
+    int n_masks;
+
+    unsigned int *pairs;            /* king cell << 8 | cell of another piece */
+    int n_pairs;
+} BenchData;
+
+volatile U64 bench_sink;
+
+/* - - - - - - - - - - POSITIONS - - - - - - - - - - */
+
+typedef struct {
+    Bitboard *positions;
+    int n;
+    int size;
+} Sampler;
+
+int sample_position(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    Sampler *s = (Sampler *)user_data;
+
+    if (info->n_moves % BENCH_PLY_STEP) return 1;
+    if (s->n == s->size) {
+        s->size = s->size ? s->size * 2 : 1024;
+        s->positions = realloc(s->positions, s->size * sizeof(Bitboard));
+    }
+    memcpy(&(s->positions[s->n++]), b, sizeof(Bitboard));
+    return 1;
+}
+
+int skip_illegal_game(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    return 1;
+}
+
+BenchKind kind_of(PieceType t)
+{
+    switch (t) {
+        case WHITE_ROOK: case BLACK_ROOK: return BENCH_ROOKS;
+        case WHITE_BISHOP: case BLACK_BISHOP: return BENCH_BISHOPS;
+        case WHITE_QUEEN: case BLACK_QUEEN: return BENCH_QUEENS;
+        case WHITE_KNIGHT: case BLACK_KNIGHT: return BENCH_KNIGHTS;
+        case WHITE_KING: return BENCH_WHITE_KINGS;
+        case BLACK_KING: return BENCH_BLACK_KINGS;
+        case WHITE_PAWN: return BENCH_WHITE_PAWNS;
+        default: return BENCH_BLACK_PAWNS;
+    }
+}
+
+void add_piece(BenchPieceList *l, BenchPiece *p, int capacity)
+{
+    if (!l->pieces) l->pieces = malloc(capacity * sizeof(BenchPiece));
+    memcpy(&(l->pieces[l->n++]), p, sizeof(BenchPiece));
+}
+
+/* everything the benchmarks iterate on is prepared here, once */
+void prepare(BenchData *d)
+{
+    int i, k, cell, capacity = d->n_positions * 32;
+
+    memset(d->kinds, 0, sizeof(d->kinds));
+    memset(&(d->all_pieces), 0, sizeof(BenchPieceList));
+    memset(&(d->movers), 0, sizeof(BenchPieceList));
+    d->moves = malloc(d->n_positions * MAX_MOVES_PER_POSITION * sizeof(BenchMove));
+    d->n_moves = 0;
+    d->masks = malloc(d->n_positions * PIECE_TYPE_COUNT * sizeof(U64));
+    d->n_masks = 0;
+    d->pairs = malloc(capacity * sizeof(unsigned int));
+    d->n_pairs = 0;
+
+    for (i=0; i<d->n_positions; i++) {
+        Bitboard *b = &(d->positions[i]);
+        PieceType own_king = (b->turn == PIECE_COLOR_WHITE) ? WHITE_KING : BLACK_KING;
+        int king_cell = _cell_of_bit(b->position[own_king]);
+
+        for (k=0; k<PIECE_TYPE_COUNT; k++) {
+            d->masks[d->n_masks++] = b->position[k];
+        }
+
+        for (cell=0; cell<64; cell++) {
+            BenchPiece p;
+            PieceType t;
+            U64 targets;
+            int is_white;
+
+            p.b = b;
+            p.file = _FILE(cell);
+            p.rank = _RANK(cell);
+            p.bit = 1ULL << cell;
+            t = get_piece_type(b, p.file, p.rank);
+            if (t == PIECE_NONE) continue;
+
+            add_piece(&(d->kinds[kind_of(t)]), &p, capacity);
+            add_piece(&(d->all_pieces), &p, capacity);
+            if (cell != king_cell) {
+                d->pairs[d->n_pairs++] = (king_cell << 8) | cell;
+            }
+
+            is_white = (t <= WHITE_KING);
+            if (is_white != (b->turn == PIECE_COLOR_WHITE)) continue;
+            add_piece(&(d->movers), &p, capacity);
+
+            targets = get_legal_moves(b, p.file, p.rank);
+            while (targets) {
+                U64 target = LS1B(targets);
+                int to = _cell_of_bit(target);
+                BenchMove *bm = &(d->moves[d->n_moves++]);
+
+                targets &= ~target;
+                bm->b = b;
+                init_move(&(bm->m));
+                bm->m.from_file = p.file;
+                bm->m.from_rank = p.rank;
+                bm->m.to_file = _FILE(to);
+                bm->m.to_rank = _RANK(to);
+                if (t == WHITE_PAWN && bm->m.to_rank == RANK_8) bm->m.promote_to = WHITE_QUEEN;
+                if (t == BLACK_PAWN && bm->m.to_rank == RANK_1) bm->m.promote_to = BLACK_QUEEN;
+            }
+        }
+    }
+}
+
+void free_bench_data(BenchData *d)
+{
+    int k;
+    for (k=0; k<BENCH_N_KINDS; k++) free(d->kinds[k].pieces);
+    free(d->all_pieces.pieces);
+    free(d->movers.pieces);
+    free(d->moves);
+    free(d->masks);
+    free(d->pairs);
+    free(d->positions);
+}
+
+/* - - - - - - - - - - BENCHMARKS - - - - - - - - - - */
+
+/* each run goes once over the data, and sets the number of calls made */
+
+U64 run_mirror(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_masks; i++) sink ^= _mirror(d->masks[i]);
+    *calls = d->n_masks;
+    return sink;
+}
+
+U64 run_count_bits(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_masks; i++) sink += _count_bits(d->masks[i]);
+    *calls = d->n_masks;
+    return sink;
+}
+
+U64 run_cell_of_bit(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->all_pieces.n; i++) sink += _cell_of_bit(d->all_pieces.pieces[i].bit);
+    *calls = d->all_pieces.n;
+    return sink;
+}
+
+U64 run_mask_between(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_pairs; i++) {
+        sink ^= _mask_between(d->pairs[i] >> 8, d->pairs[i] & 0xFF);
+    }
+    *calls = d->n_pairs;
+    return sink;
+}
+
+/* calls expr for each piece p of the list */
+#define RUN_PIECES(name, list, expr) \
+U64 name(BenchData *d, unsigned long long *calls) \
+{ \
+    BenchPieceList *l = (list); \
+    U64 sink = 0; \
+    int i; \
+    for (i=0; i<l->n; i++) { \
+        BenchPiece *p = &(l->pieces[i]); \
+        sink ^= (expr); \
+    } \
+    *calls = l->n; \
+    return sink; \
+}
+
+/*
+ * Same over positions whose attack maps are dropped once per pass, so the
+ * first piece of each position pays for filling them, as in a new search node.
+ */
+#define RUN_PIECES_COLD(name, list, expr) \
+U64 name(BenchData *d, unsigned long long *calls) \
+{ \
+    BenchPieceList *l = (list); \
+    U64 sink = 0; \
+    int i; \
+    for (i=0; i<d->n_positions; i++) \
+        bitboard_invalidate_attacks(&(d->positions[i])); \
+    for (i=0; i<l->n; i++) { \
+        BenchPiece *p = &(l->pieces[i]); \
+        sink ^= (expr); \
+    } \
+    *calls = l->n; \
+    return sink; \
+}
+
+RUN_PIECES(run_rook_attacks, &(d->kinds[BENCH_ROOKS]),
+    get_rook_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_bishop_attacks, &(d->kinds[BENCH_BISHOPS]),
+    get_bishop_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_queen_attacks, &(d->kinds[BENCH_QUEENS]),
+    get_queen_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_knight_attacks, &(d->kinds[BENCH_KNIGHTS]),
+    get_knight_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_white_king_attacks, &(d->kinds[BENCH_WHITE_KINGS]),
+    get_white_king_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_black_king_attacks, &(d->kinds[BENCH_BLACK_KINGS]),
+    get_black_king_attacks(p->b, p->file, p->rank, p->bit))
+RUN_PIECES(run_white_pawn_attacks, &(d->kinds[BENCH_WHITE_PAWNS]),
+    get_white_pawn_attacks(p->b, p->file, p->rank, p->bit, 0))
+RUN_PIECES(run_black_pawn_attacks, &(d->kinds[BENCH_BLACK_PAWNS]),
+    get_black_pawn_attacks(p->b, p->file, p->rank, p->bit, 0))
+RUN_PIECES_COLD(run_attacks_to_square, &(d->all_pieces),
+    get_attacks_to_square(p->b, p->file, p->rank))
+RUN_PIECES_COLD(run_legal_moves, &(d->movers),
+    get_legal_moves(p->b, p->file, p->rank))
+
+/* includes copying the position to a scratch board */
+U64 run_do_move(BenchData *d, unsigned long long *calls)
+{
+    Bitboard scratch;
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_moves; i++) {
+        memcpy(&scratch, d->moves[i].b, sizeof(Bitboard));
+        bitboard_do_move(&scratch, &(d->moves[i].m));
+        sink ^= scratch.hash;
+    }
+    *calls = d->n_moves;
+    return sink;
+}
+
+U64 run_is_legal_move(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_moves; i++) {
+        sink += is_legal_move(d->moves[i].b, &(d->moves[i].m));
+    }
+    *calls = d->n_moves;
+    return sink;
+}
+
+U64 run_is_pseudo_legal(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_moves; i++) {
+        sink += bitboard_is_pseudo_legal(d->moves[i].b, &(d->moves[i].m));
+    }
+    *calls = d->n_moves;
+    return sink;
+}
+
+U64 run_see(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_moves; i++) {
+        sink += (U64)bitboard_see(d->moves[i].b, &(d->moves[i].m));
+    }
+    *calls = d->n_moves;
+    return sink;
+}
+
+/* includes destroying the clone */
+U64 run_clone(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_positions; i++) {
+        Bitboard *b = clone_bitboard(&(d->positions[i]));
+        sink ^= b->hash;
+        destroy_bitboard(b);
+    }
+    *calls = d->n_positions;
+    return sink;
+}
+
+/* both colors, each call */
+U64 run_attacks_by(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_positions; i++) {
+        sink ^= bitboard_get_attacks_by(&(d->positions[i]), PIECE_COLOR_WHITE);
+        sink ^= bitboard_get_attacks_by(&(d->positions[i]), PIECE_COLOR_BLACK);
+    }
+    *calls = 2 * d->n_positions;
+    return sink;
+}
+
+U64 run_center_attackers(BenchData *d, unsigned long long *calls)
+{
+    U64 sink = 0;
+    int i;
+    for (i=0; i<d->n_positions; i++) {
+        sink ^= bitboard_get_center_attackers(&(d->positions[i]));
+    }
+    *calls = d->n_positions;
+    return sink;
+}
+
+/*
+ * Evaluation with the material, piece count and center occupation terms
+ * (always computed) plus the terms kept by setup, the others set to 0. The
+ * attack maps are dropped before each call, as in a new search node.
+ */
+#define RUN_EVAL(name, setup) \
+U64 name(BenchData *d, unsigned long long *calls) \
+{ \
+    EvalWeights w, all; \
+    U64 sink = 0; \
+    int i; \
+    init_eval_weights(&all); \
+    memset(&w, 0, sizeof(EvalWeights)); \
+    w.material = all.material; \
+    w.piece_count = all.piece_count; \
+    w.center_occupation = all.center_occupation; \
+    setup; \
+    for (i=0; i<d->n_positions; i++) { \
+        bitboard_invalidate_attacks(&(d->positions[i])); \
+        sink += (U64)evaluate_bitboard_weights(&(d->positions[i]), \
+            PIECE_COLOR_WHITE, &w); \
+    } \
+    *calls = d->n_positions; \
+    return sink; \
+}
+
+RUN_EVAL(run_eval_base, )
+RUN_EVAL(run_eval_center_attackers,
+    w.center_attackers = all.center_attackers)
+RUN_EVAL(run_eval_mobility,
+    w.mobility_knight = all.mobility_knight;
+    w.mobility_bishop = all.mobility_bishop;
+    w.mobility_rook = all.mobility_rook;
+    w.mobility_queen = all.mobility_queen)
+RUN_EVAL(run_eval_king_zone,
+    w.king_zone_attacks = all.king_zone_attacks)
+RUN_EVAL(run_eval_all, w = all)
+
+typedef struct {
+    const char *name;
+    U64 (*run)(BenchData *d, unsigned long long *calls);
+} Benchmark;
+
+Benchmark benchmarks[] = {
+    { "_mirror", run_mirror },
+    { "_cell_of_bit", run_cell_of_bit },
+    { "_count_bits", run_count_bits },
+    { "_mask_between", run_mask_between },
+    { "get_rook_attacks", run_rook_attacks },
+    { "get_bishop_attacks", run_bishop_attacks },
+    { "get_queen_attacks", run_queen_attacks },
+    { "get_knight_attacks", run_knight_attacks },
+    { "get_white_king_attacks", run_white_king_attacks },
+    { "get_black_king_attacks", run_black_king_attacks },
+    { "get_white_pawn_attacks", run_white_pawn_attacks },
+    { "get_black_pawn_attacks", run_black_pawn_attacks },
+    { "get_attacks_to_square", run_attacks_to_square },
+    { "get_legal_moves", run_legal_moves },
+    { "bitboard_get_attacks_by", run_attacks_by },
+    { "bitboard_get_center_attackers", run_center_attackers },
+    { "eval: base terms", run_eval_base },
+    { "eval: + center_attackers", run_eval_center_attackers },
+    { "eval: + mobility", run_eval_mobility },
+    { "eval: + king_zone_attacks", run_eval_king_zone },
+    { "evaluate_bitboard_weights", run_eval_all },
+    { "is_legal_move", run_is_legal_move },
+    { "bitboard_is_pseudo_legal", run_is_pseudo_legal },
+    { "bitboard_see", run_see },
+    { "bitboard_do_move", run_do_move },
+    { "clone_bitboard", run_clone },
+    { NULL, NULL }
+};
+
+/* - - - - - - - - - - TIMING - - - - - - - - - - */
+
+typedef struct {
+    unsigned long long calls;   /* per sample */
+    int passes;                 /* over the data, per sample */
+    double min, median, p90, p99, max, mean;
+} BenchResult;
+
+long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ns taken by passes runs of b */
+long long time_sample(Benchmark *b, BenchData *d, int passes, unsigned long long *calls)
+{
+    long long start = now_ns();
+    int i;
+    for (i=0; i<passes; i++) bench_sink ^= b->run(d, calls);
+    return now_ns() - start;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of n sorted values */
+#define PERCENTILE(values, n, p) ((values)[((n) * (p) + 99) / 100 - 1])
+
+void run_benchmark(Benchmark *b, BenchData *d, int warmup, int repetitions,
+    BenchResult *r)
+{
+    double *samples = malloc(repetitions * sizeof(double));
+    unsigned long long calls = 0;
+    double sum = 0.0;
+    int i;
+
+    /* a sample must last long enough for the clock to be accurate */
+    r->passes = 1;
+    while (time_sample(b, d, r->passes, &calls) < BENCH_MIN_SAMPLE_NS
+        && r->passes < (1 << 24)) {
+        r->passes *= 2;
+    }
+    r->calls = calls * r->passes;
+
+    for (i=0; i<warmup; i++) time_sample(b, d, r->passes, &calls);
+    for (i=0; i<repetitions; i++) {
+        long long ns = time_sample(b, d, r->passes, &calls);
+        samples[i] = r->calls ? (double)ns / r->calls : 0.0;
+        sum += samples[i];
+    }
+
+    qsort(samples, repetitions, sizeof(double), compare_doubles);
+    r->min = samples[0];
+    r->median = PERCENTILE(samples, repetitions, 50);
+    r->p90 = PERCENTILE(samples, repetitions, 90);
+    r->p99 = PERCENTILE(samples, repetitions, 99);
+    r->max = samples[repetitions - 1];
+    r->mean = sum / repetitions;
+    free(samples);
+}
+
+/* - - - - - - - - - - MAIN - - - - - - - - - - */
+
+int load_positions(const char *path, int n, BenchData *d)
+{
+    GameReaderCallbacks callbacks;
+    GameReader *reader;
+    Sampler sampler;
+    int fd, i, result;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+
+    memset(&sampler, 0, sizeof(Sampler));
+    memset(&callbacks, 0, sizeof(GameReaderCallbacks));
+    callbacks.on_move = sample_position;
+    callbacks.on_illegal_move = skip_illegal_game;
+    callbacks.user_data = &sampler;
+
+    reader = create_game_reader(&callbacks);
+    result = game_reader_parse_fd(reader, fd);
+    game_reader_finish(reader);
+    destroy_game_reader(reader);
+    close(fd);
+
+    if (result < 0 || !sampler.n) {
+        fprintf(stderr, "%s: no positions found\n", path);
+        free(sampler.positions);
+        return 0;
+    }
+
+    /* evenly spaced, from all the games */
+    if (n > sampler.n) n = sampler.n;
+    d->positions = malloc(n * sizeof(Bitboard));
+    d->n_positions = n;
+    for (i=0; i<n; i++) {
+        memcpy(&(d->positions[i]),
+            &(sampler.positions[(long long)i * sampler.n / n]), sizeof(Bitboard));
+    }
+    free(sampler.positions);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = BENCH_DEFAULT_GAMES;
+    const char *filter = NULL;
+    int n_positions = BENCH_DEFAULT_POSITIONS;
+    int warmup = BENCH_DEFAULT_WARMUP;
+    int repetitions = BENCH_DEFAULT_REPETITIONS;
+    int i, first = 1;
+    BenchData data;
+    BenchResult r;
+
+    for (i=1; i<argc; i++) {
+        int has_value = (i + 1 < argc);
+        if (!strcmp(argv[i], "-n") && has_value) n_positions = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && has_value) warmup = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && has_value) repetitions = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && has_value) filter = argv[++i];
+        else if (argv[i][0] != '-') path = argv[i];
+        else break;
+    }
+    if (i < argc || n_positions < 1 || warmup < 0 || repetitions < 1) {
+        fprintf(stderr, "usage: %s [-n <positions>] [-w <warmup>] [-r <repetitions>] "
+            "[-b <name>] [games.whalg]\n", argv[0]);
+        return 1;
+    }
+
+    if (!load_positions(path, n_positions, &data)) return 1;
+    prepare(&data);
+
+    fprintf(stderr, "%d positions from %s, %d pieces, %d moves\n",
+        data.n_positions, path, data.all_pieces.n, data.n_moves);
+    fprintf(stderr, "%-30s %12s %9s %9s %9s %9s %9s\n", "ns per call", "calls",
+        "min", "median", "p90", "p99", "max");
+
+    printf("{\n");
+    printf("  \"games\": \"%s\",\n", path);
+    printf("  \"positions\": %d,\n", data.n_positions);
+    printf("  \"warmup\": %d,\n", warmup);
+    printf("  \"repetitions\": %d,\n", repetitions);
+    printf("  \"unit\": \"ns\",\n");
+    printf("  \"benchmarks\": [");
+
+    for (i=0; benchmarks[i].name; i++) {
+        Benchmark *b = &(benchmarks[i]);
+        if (filter && !strstr(b->name, filter)) continue;
+
+        run_benchmark(b, &data, warmup, repetitions, &r);
+
+        fprintf(stderr, "%-30s %12llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", b->name,
+            r.calls, r.min, r.median, r.p90, r.p99, r.max);
+        printf("%s\n    {\"name\": \"%s\", \"calls\": %llu, \"passes\": %d, "
+            "\"min\": %.3f, \"median\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+            "\"max\": %.3f, \"mean\": %.3f}",
+            first ? "" : ",", b->name, r.calls, r.passes,
+            r.min, r.median, r.p90, r.p99, r.max, r.mean);
+        fflush(stdout);
+        first = 0;
+    }
+    printf("\n  ]\n}\n");
+
+    free_bench_data(&data);
+    return 0;
+}
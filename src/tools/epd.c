@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "profile.h"
+
+/*
+ * Runs a test suite of EPD positions with bm (best moves) or am (avoid moves)
+ * operations, and reports how many were solved and how fast.
+ *
+ * usage: epd_runner [-t <movetime ms>] [-n <nodes>] [-d <depth>]
+ *                   [-j <workers>] [-H <hash MB per worker>] [-v] <suite.epd>
+ *
+ * A position is solved when the move chosen at the end of the search is a
+ * best move (not an avoid move). It was solved at the first iteration after
+ * which the chosen move stayed right: time and nodes to solution are taken
+ * from that iteration.
+ *
+ * When built with PROFILE=1, the cycle counters of the whole run follow.
+ */
+
+#define EPD_LINE_SIZE 1024
+#define EPD_MAX_MOVES 8
+#define EPD_DEFAULT_MOVETIME 1000
+#define EPD_DEFAULT_HASH_MB 16
+
+typedef struct {
+    char id[64];
+    char fen[FEN_MAX_LENGTH];
+    Move moves[EPD_MAX_MOVES];  /* best moves, or moves to avoid */
+    int n_moves;
+    int avoid;
+
+    /* results */
+    Move played;
+    int solved;
+    long solved_ms;
+    unsigned long long solved_nodes;
+    long time_ms;
+    unsigned long long nodes;
+    int depth;
+    SearchStats stats;
+} EpdPosition;
+
+typedef struct {
+    EpdPosition *positions;
+    int n_positions;
+    volatile int next_position;
+    SearchOptions options;
+    unsigned int hash_mb;
+} EpdSuite;
+
+/* the position searched by the current thread, for the iteration callback */
+__thread EpdPosition *current_position = NULL;
+
+/* - - - - - - - - - - PARSING - - - - - - - - - - */
+
+/* operands of bm/am: SAN moves separated by spaces, up to the ';' */
+int parse_moves(Bitboard *b, char *operands, EpdPosition *pos)
+{
+    char *token, *save;
+
+    for (token = strtok_r(operands, " ", &save); token && pos->n_moves < EPD_MAX_MOVES;
+         token = strtok_r(NULL, " ", &save)) {
+        if (!move_from_san(b, token, &(pos->moves[pos->n_moves]))) return 0;
+        pos->n_moves++;
+    }
+    return pos->n_moves > 0;
+}
+
+/* returns 0 if the line is not a position with bm or am */
+int parse_epd_line(char *line, EpdPosition *pos)
+{
+    char *p = line, *op, *end;
+    int fields = 0;
+    Bitboard *b;
+
+    memset(pos, 0, sizeof(EpdPosition));
+
+    /* the first four fields are a FEN without move counters */
+    while (*p && fields < 4) {
+        while (*p == ' ') p++;
+        while (*p && *p != ' ') p++;
+        fields++;
+    }
+    if (fields < 4 || (size_t)(p - line) >= FEN_MAX_LENGTH) return 0;
+    memcpy(pos->fen, line, p - line);
+    pos->fen[p - line] = '\0';
+
+    b = bitboard_from_fen(pos->fen);
+    if (!b) return 0;
+
+    /* operations: opcode operands; */
+    for (op = p; *op; op = end) {
+        while (*op == ' ') op++;
+        end = strchr(op, ';');
+        if (!end) end = op + strlen(op);
+        else *(end++) = '\0';
+
+        if (!strncmp(op, "bm ", 3) || !strncmp(op, "am ", 3)) {
+            pos->avoid = (op[0] == 'a');
+            if (!parse_moves(b, op + 3, pos)) pos->n_moves = 0;
+        }
+        else if (!strncmp(op, "id ", 3)) {
+            char *id = op + 3;
+            size_t len;
+            while (*id == ' ' || *id == '"') id++;
+            len = strcspn(id, "\"");
+            if (len >= sizeof(pos->id)) len = sizeof(pos->id) - 1;
+            memcpy(pos->id, id, len);
+            pos->id[len] = '\0';
+        }
+    }
+
+    destroy_bitboard(b);
+    return pos->n_moves > 0;
+}
+
+EpdPosition *load_epd_file(const char *filename, int *n_positions)
+{
+    char line[EPD_LINE_SIZE];
+    int size = 64, n = 0, line_number = 0;
+    EpdPosition *positions;
+    FILE *f = fopen(filename, "r");
+
+    if (!f) {
+        perror(filename);
+        return NULL;
+    }
+    positions = malloc(size * sizeof(EpdPosition));
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!line[0] || line[0] == '#') continue;
+
+        if (n == size) {
+            size *= 2;
+            positions = realloc(positions, size * sizeof(EpdPosition));
+        }
+        if (!parse_epd_line(line, &(positions[n]))) {
+            fprintf(stderr, "%s:%d: skipped, no legal bm/am moves\n",
+                filename, line_number);
+            continue;
+        }
+        if (!positions[n].id[0]) sprintf(positions[n].id, "line %d", line_number);
+        n++;
+    }
+    fclose(f);
+
+    *n_positions = n;
+    return positions;
+}
+
+/* - - - - - - - - - - SEARCH - - - - - - - - - - */
+
+int is_solution(EpdPosition *pos, Move *m)
+{
+    int i, listed = 0;
+    for (i=0; i<pos->n_moves; i++) {
+        if (is_same_move(&(pos->moves[i]), m)) listed = 1;
+    }
+    return pos->avoid ? !listed : listed;
+}
+
+void on_iteration(SearchResult *result)
+{
+    EpdPosition *pos = current_position;
+
+    if (!is_solution(pos, &(result->best_move))) {
+        pos->solved = 0;
+    }
+    else if (!pos->solved) {
+        pos->solved = 1;
+        pos->solved_ms = result->time_ms;
+        pos->solved_nodes = result->nodes;
+    }
+}
+
+void *epd_worker(void *arg)
+{
+    EpdSuite *suite = (EpdSuite *)arg;
+    SearchOptions options = suite->options;
+    TranspositionTable *tt = create_transposition_table(suite->hash_mb);
+    SearchResult result;
+    int i;
+
+    options.tt = tt;
+    options.callback_iteration = on_iteration;
+
+    while ((i = __sync_fetch_and_add(&(suite->next_position), 1)) < suite->n_positions) {
+        EpdPosition *pos = &(suite->positions[i]);
+        Bitboard *b = bitboard_from_fen(pos->fen);
+
+        clear_transposition_table(tt);
+        current_position = pos;
+        engine_search(b, b->turn, &options, &result);
+
+        pos->played = result.best_move;
+        pos->solved = pos->solved && is_solution(pos, &(result.best_move));
+        pos->time_ms = result.time_ms;
+        pos->nodes = result.nodes;
+        pos->depth = result.depth;
+        pos->stats = result.stats;
+        destroy_bitboard(b);
+    }
+
+    destroy_transposition_table(tt);
+    return NULL;
+}
+
+/* - - - - - - - - - - REPORT - - - - - - - - - - */
+
+int compare_longs(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+int compare_counts(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of n sorted values */
+#define PERCENTILE(values, n, p) ((values)[((n) * (p) + 99) / 100 - 1])
+
+void report(EpdSuite *suite, double seconds, int verbose)
+{
+    long *times = malloc((suite->n_positions + 1) * sizeof(long));
+    unsigned long long *nodes = malloc((suite->n_positions + 1) * sizeof(unsigned long long));
+    unsigned long long total_nodes = 0;
+    SearchStats total_stats;
+    double total_ebf = 0.0;
+    int i, n_solved = 0, n_ebf = 0;
+    char san[8];
+
+    memset(&total_stats, 0, sizeof(SearchStats));
+    for (i=0; i<suite->n_positions; i++) {
+        EpdPosition *pos = &(suite->positions[i]);
+        Bitboard *b = bitboard_from_fen(pos->fen);
+
+        move_to_san(b, &(pos->played), san);
+        total_nodes += pos->nodes;
+        merge_search_stats(&total_stats, &(pos->stats));
+        if (search_stats_branching_factor(&(pos->stats)) > 0) {
+            total_ebf += search_stats_branching_factor(&(pos->stats));
+            n_ebf++;
+        }
+        if (pos->solved) {
+            times[n_solved] = pos->solved_ms;
+            nodes[n_solved] = pos->solved_nodes;
+            n_solved++;
+        }
+        if (verbose || !pos->solved) {
+            printf("%-24s %-6s %-7s depth %2d, %6ld ms, %10llu nodes",
+                pos->id, pos->solved ? "solved" : "FAILED", san,
+                pos->depth, pos->time_ms, pos->nodes);
+            if (pos->solved) {
+                printf(" (solved in %ld ms, %llu nodes)", pos->solved_ms,
+                    pos->solved_nodes);
+            }
+            printf("\n");
+        }
+        destroy_bitboard(b);
+    }
+
+    printf("Solved %d/%d positions (%.1f%%) in %.1f s, %.0f nodes/s.\n",
+        n_solved, suite->n_positions,
+        suite->n_positions ? 100.0 * n_solved / suite->n_positions : 0.0,
+        seconds, seconds > 0 ? total_nodes / seconds : 0.0);
+    printf("Search: %.1f%% first move cutoffs, mean EBF %.2f, %.1f%% quiescence nodes\n",
+        100.0 * search_stats_first_move_cutoff_rate(&total_stats),
+        n_ebf ? total_ebf / n_ebf : 0.0,
+        total_nodes ? 100.0 * total_stats.qnodes / total_nodes : 0.0);
+    printf("Hash: %.1f%% hits, %.1f%% cutoffs of %llu probes\n",
+        total_stats.tt_probes ? 100.0 * total_stats.tt_hits / total_stats.tt_probes : 0.0,
+        total_stats.tt_probes ? 100.0 * total_stats.tt_cutoffs / total_stats.tt_probes : 0.0,
+        total_stats.tt_probes);
+
+    if (n_solved) {
+        qsort(times, n_solved, sizeof(long), compare_longs);
+        qsort(nodes, n_solved, sizeof(unsigned long long), compare_counts);
+        printf("Time to solution (ms):  p50 %ld, p90 %ld, p99 %ld, max %ld\n",
+            PERCENTILE(times, n_solved, 50), PERCENTILE(times, n_solved, 90),
+            PERCENTILE(times, n_solved, 99), times[n_solved - 1]);
+        printf("Nodes to solution:      p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+            PERCENTILE(nodes, n_solved, 50), PERCENTILE(nodes, n_solved, 90),
+            PERCENTILE(nodes, n_solved, 99), nodes[n_solved - 1]);
+    }
+
+    free(times);
+    free(nodes);
+}
+
+double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    int n_workers = 1, verbose = 0, i;
+    EpdSuite suite;
+    pthread_t *workers;
+    struct timespec start;
+
+    memset(&suite, 0, sizeof(EpdSuite));
+    init_search_options(&(suite.options));
+    suite.hash_mb = EPD_DEFAULT_HASH_MB;
+
+    for (i=1; i<argc; i++) {
+        int has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "-v")) verbose = 1;
+        else if (!strcmp(argv[i], "-t") && has_value) suite.options.movetime = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && has_value) suite.options.nodes = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-d") && has_value) suite.options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-H") && has_value) suite.hash_mb = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && has_value) {
+            n_workers = atoi(argv[++i]);
+            if (n_workers <= 0) n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else filename = argv[i];
+    }
+    if (!filename) {
+        fprintf(stderr, "usage: %s [-t <movetime ms>] [-n <nodes>] [-d <depth>] "
+            "[-j <workers>] [-H <hash MB per worker>] [-v] <suite.epd>\n", argv[0]);
+        return 1;
+    }
+
+    /* some limit is needed, otherwise each search goes to the default depth */
+    if (!suite.options.movetime && !suite.options.nodes && !suite.options.depth) {
+        suite.options.movetime = EPD_DEFAULT_MOVETIME;
+    }
+
+    suite.positions = load_epd_file(filename, &(suite.n_positions));
+    if (!suite.positions) return 1;
+
+    workers = malloc(n_workers * sizeof(pthread_t));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i=0; i<n_workers; i++) {
+        pthread_create(&(workers[i]), NULL, epd_worker, &suite);
+    }
+    for (i=0; i<n_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    report(&suite, elapsed_seconds(&start), verbose);
+    if (profile_enabled()) profile_dump(stdout, "");
+
+    free(workers);
+    free(suite.positions);
+    return 0;
+}
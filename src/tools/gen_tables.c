@@ -0,0 +1,189 @@
+#include <stdio.h>
+
+#include "bitboard.h"
+#include "tables.h"
+
+/*
+ * Generates src/tables.c, the constant tables declared in tables.h. Run by
+ * the Makefile before anything else is compiled, so it must only depend on
+ * headers.
+ *
+ * usage: gen_tables > src/tables.c
+ */
+
+#define VALUES_PER_LINE 4
+
+/* file and rank steps, in the order of RayDirection */
+const int ray_steps[RAY_COUNT][2] = {
+    { 0, 1 }, { 1, 1 }, { 1, 0 }, { 1, -1 },
+    { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 }
+};
+
+const int knight_steps[8][2] = {
+    { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 },
+    { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 }
+};
+
+int on_board(int file, int rank)
+{
+    return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+U64 cell_bit(int file, int rank)
+{
+    return 1ULL << (rank * 8 + file);
+}
+
+U64 ray(int direction, int cell)
+{
+    int file = _FILE(cell), rank = _RANK(cell);
+    U64 result = 0ULL;
+
+    file += ray_steps[direction][0];
+    rank += ray_steps[direction][1];
+    while (on_board(file, rank)) {
+        result |= cell_bit(file, rank);
+        file += ray_steps[direction][0];
+        rank += ray_steps[direction][1];
+    }
+    return result;
+}
+
+/* as _mask_between used to compute it, diagonal steps first */
+U64 between(int from, int to)
+{
+    int x1 = _FILE(from), y1 = _RANK(from);
+    int x2 = _FILE(to), y2 = _RANK(to);
+    U64 result = 0ULL;
+
+    while (x1 != x2 || y1 != y2) {
+        if (x2 != x1) x1 += (x2 > x1) ? 1 : -1;
+        if (y2 != y1) y1 += (y2 > y1) ? 1 : -1;
+        result |= cell_bit(x1, y1);
+    }
+    return result & ~cell_bit(x2, y2);
+}
+
+U64 line(int from, int to)
+{
+    int direction;
+
+    for (direction=0; direction<RAY_COUNT; direction++) {
+        if (ray(direction, from) & (1ULL << to)) {
+            return ray(direction, from) | ray((direction + 4) % RAY_COUNT, from)
+                | (1ULL << from);
+        }
+    }
+    return 0ULL;
+}
+
+U64 steps(int cell, const int (*deltas)[2], int n)
+{
+    int i, file, rank;
+    U64 result = 0ULL;
+
+    for (i=0; i<n; i++) {
+        file = _FILE(cell) + deltas[i][0];
+        rank = _RANK(cell) + deltas[i][1];
+        if (on_board(file, rank)) result |= cell_bit(file, rank);
+    }
+    return result;
+}
+
+U64 pawn_attacks(int is_white, int cell)
+{
+    int deltas[2][2] = { { -1, 1 }, { 1, 1 } };
+    if (!is_white) {
+        deltas[0][1] = deltas[1][1] = -1;
+    }
+    return steps(cell, (const int (*)[2])deltas, 2);
+}
+
+/* xorshift64*, the seed and the order of the draws fix the Zobrist keys */
+U64 zobrist_seed = 0x9E3779B97F4A7C15ULL;
+
+U64 next_random()
+{
+    zobrist_seed ^= zobrist_seed >> 12;
+    zobrist_seed ^= zobrist_seed << 25;
+    zobrist_seed ^= zobrist_seed >> 27;
+    return zobrist_seed * 0x2545F4914F6CDD1DULL;
+}
+
+/* - - - - - - - - - - OUTPUT - - - - - - - - - - */
+
+void print_values(const U64 *values, int n, const char *indent)
+{
+    int i;
+    for (i=0; i<n; i++) {
+        if (!(i % VALUES_PER_LINE)) printf("%s", indent);
+        printf("0x%016llxULL,", values[i]);
+        printf((i % VALUES_PER_LINE == VALUES_PER_LINE - 1 || i == n - 1) ? "\n" : " ");
+    }
+}
+
+void print_table(const char *declaration, const U64 *values, int n)
+{
+    printf("\nconst U64 %s = {\n", declaration);
+    print_values(values, n, "    ");
+    printf("};\n");
+}
+
+void print_table_2d(const char *declaration, const U64 (*values)[64], int n)
+{
+    int i;
+    printf("\nconst U64 %s = {\n", declaration);
+    for (i=0; i<n; i++) {
+        printf("    { /* %d */\n", i);
+        print_values(values[i], 64, "        ");
+        printf("    },\n");
+    }
+    printf("};\n");
+}
+
+int main(int argc, char **argv)
+{
+    static U64 between_masks[64][64], line_masks[64][64];
+    U64 zobrist_piece[PIECE_TYPE_COUNT][64], zobrist_castling[4], zobrist_enpassant[8];
+    U64 zobrist_black_to_move;
+    U64 ray_masks[RAY_COUNT][64], pawn_masks[2][64];
+    U64 knight_masks[64], king_masks[64];
+    int i, k;
+
+    for (i=0; i<64; i++) {
+        for (k=0; k<64; k++) {
+            between_masks[i][k] = between(i, k);
+            line_masks[i][k] = line(i, k);
+        }
+        for (k=0; k<RAY_COUNT; k++) {
+            ray_masks[k][i] = ray(k, i);
+        }
+        knight_masks[i] = steps(i, knight_steps, 8);
+        king_masks[i] = steps(i, ray_steps, RAY_COUNT);
+        pawn_masks[0][i] = pawn_attacks(1, i);
+        pawn_masks[1][i] = pawn_attacks(0, i);
+    }
+
+    for (i=0; i<PIECE_TYPE_COUNT; i++) {
+        for (k=0; k<64; k++) zobrist_piece[i][k] = next_random();
+    }
+    for (k=0; k<4; k++) zobrist_castling[k] = next_random();
+    for (k=0; k<8; k++) zobrist_enpassant[k] = next_random();
+    zobrist_black_to_move = next_random();
+
+    printf("/* generated by src/tools/gen_tables.c, do not edit */\n");
+    printf("#include \"bitboard.h\"\n");
+    printf("#include \"tables.h\"\n");
+    print_table_2d("_between_masks[64][64]", (const U64 (*)[64])between_masks, 64);
+    print_table_2d("_line_masks[64][64]", (const U64 (*)[64])line_masks, 64);
+    print_table_2d("_ray_masks[RAY_COUNT][64]", (const U64 (*)[64])ray_masks, RAY_COUNT);
+    print_table("_knight_attacks[64]", knight_masks, 64);
+    print_table("_king_attacks[64]", king_masks, 64);
+    print_table_2d("_pawn_attacks[2][64]", (const U64 (*)[64])pawn_masks, 2);
+    print_table_2d("_zobrist_piece[PIECE_TYPE_COUNT][64]",
+        (const U64 (*)[64])zobrist_piece, PIECE_TYPE_COUNT);
+    print_table("_zobrist_castling[4]", zobrist_castling, 4);
+    print_table("_zobrist_enpassant[8]", zobrist_enpassant, 8);
+    printf("\nconst U64 _zobrist_black_to_move = 0x%016llxULL;\n", zobrist_black_to_move);
+    return 0;
+}
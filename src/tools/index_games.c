@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitboard.h"
+#include "gamepack.h"
+#include "positionindex.h"
+
+/*
+ * Builds and queries position indexes (see positionindex.h).
+ *
+ * usage: index_games build [-j <threads>] <games.smog> <games.idx>
+ *        index_games find <games.idx> [-f <fen>] [move ...]
+ *
+ * find looks for the position reached by the moves, in coordinate notation
+ * (e.g., "e2e4 c7c5"), from the FEN or the initial position.
+ */
+
+#define MAX_MATCHES_SHOWN 20
+
+double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int cmd_build(int argc, char **argv)
+{
+    const char *pack_filename = NULL, *index_filename = NULL;
+    int n_threads = 1, fd, i;
+    struct timespec start;
+    long long n_entries;
+    GamePack *pack;
+    FILE *out;
+
+    for (i=0; i<argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+            if (n_threads <= 0) n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else if (!pack_filename) pack_filename = argv[i];
+        else index_filename = argv[i];
+    }
+    if (!index_filename) {
+        fprintf(stderr, "usage: index_games build [-j <threads>] <games.smog> <games.idx>\n");
+        return 1;
+    }
+
+    fd = open(pack_filename, O_RDONLY);
+    pack = (fd < 0) ? NULL : open_game_pack(fd);
+    if (fd >= 0) close(fd);
+    if (!pack) {
+        fprintf(stderr, "%s: not a packed game file\n", pack_filename);
+        return 1;
+    }
+    out = fopen(index_filename, "wb");
+    if (!out) {
+        perror(index_filename);
+        close_game_pack(pack);
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    n_entries = build_position_index(pack, out, n_threads);
+    if (fclose(out) == EOF) n_entries = -1;
+    close_game_pack(pack);
+
+    if (n_entries < 0) {
+        perror(index_filename);
+        return 1;
+    }
+    printf("Indexed %lld positions in %.3f s with %d thread(s).\n",
+        n_entries, elapsed_seconds(&start), n_threads);
+    return 0;
+}
+
+int cmd_find(int argc, char **argv)
+{
+    const PositionIndexEntry *first;
+    unsigned long long n, i;
+    PositionIndex *idx;
+    const char *fen = FEN_INITIAL_POSITION;
+    Bitboard *b;
+    Move m;
+    int fd;
+
+    if (argc < 1) {
+        fprintf(stderr, "usage: index_games find <games.idx> [-f <fen>] [move ...]\n");
+        return 1;
+    }
+
+    fd = open(argv[0], O_RDONLY);
+    idx = (fd < 0) ? NULL : open_position_index(fd);
+    if (fd >= 0) close(fd);
+    if (!idx) {
+        fprintf(stderr, "%s: not a position index\n", argv[0]);
+        return 1;
+    }
+
+    i = 1;
+    if (argc > 2 && !strcmp(argv[1], "-f")) {
+        fen = argv[2];
+        i = 3;
+    }
+    b = bitboard_from_fen(fen);
+    if (!b) {
+        fprintf(stderr, "bad FEN: %s\n", fen);
+        close_position_index(idx);
+        return 1;
+    }
+
+    for (; i<(unsigned long long)argc; i++) {
+        if (!move_from_string(b, argv[i], &m) || !is_legal_move(b, &m)) {
+            fprintf(stderr, "illegal move: %s\n", argv[i]);
+            destroy_bitboard(b);
+            close_position_index(idx);
+            return 1;
+        }
+        bitboard_do_move(b, &m);
+    }
+
+    n = position_index_find(idx, bitboard_key(b, b->turn), &first);
+    printf("%llu match(es)\n", n);
+    for (i=0; i<n && i<MAX_MATCHES_SHOWN; i++) {
+        printf("game %u, ply %u\n", first[i].game_id, first[i].ply);
+    }
+    if (n > MAX_MATCHES_SHOWN) printf("...\n");
+
+    destroy_bitboard(b);
+    close_position_index(idx);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "build")) return cmd_build(argc - 2, argv + 2);
+    if (argc >= 2 && !strcmp(argv[1], "find")) return cmd_find(argc - 2, argv + 2);
+
+    fprintf(stderr, "usage: %s build [-j <threads>] <games.smog> <games.idx>\n", argv[0]);
+    fprintf(stderr, "       %s find <games.idx> [-f <fen>] [move ...]\n", argv[0]);
+    return 1;
+}
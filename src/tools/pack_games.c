@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bitboard.h"
+#include "gamereader.h"
+#include "gamepack.h"
+
+/*
+ * Converts games in long algebraic notation to a packed game file (see
+ * gamepack.h). Games with illegal moves are left out.
+ *
+ * usage: pack_games <input.whalg> <output.smog>
+ */
+
+typedef struct {
+    GamePackWriter *writer;
+    uint16_t *moves;
+    unsigned int moves_size;
+    unsigned long long n_games;
+    unsigned long long n_moves;
+    unsigned long long n_illegal_games;
+} Packer;
+
+int pack_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    Packer *p = (Packer *)user_data;
+
+    if (info->n_moves > p->moves_size) {
+        p->moves_size *= 2;
+        p->moves = realloc(p->moves, p->moves_size * sizeof(uint16_t));
+    }
+    p->moves[info->n_moves - 1] = game_pack_encode_move(m);
+    return 1;
+}
+
+int skip_illegal_game(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    ((Packer *)user_data)->n_illegal_games++;
+    return 1;
+}
+
+void pack_game(GameInfo *info, void *user_data)
+{
+    Packer *p = (Packer *)user_data;
+
+    if (info->illegal || !info->n_moves) return;
+    game_pack_write_game(p->writer, info, p->moves, info->n_moves);
+    p->n_games++;
+    p->n_moves += info->n_moves;
+}
+
+int main(int argc, char **argv)
+{
+    Packer packer;
+    GameReaderCallbacks callbacks = {
+        NULL, pack_move, skip_illegal_game, pack_game, &packer
+    };
+    GameReader *reader;
+    struct stat st_in, st_out;
+    FILE *out;
+    int fd, result;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <input.whalg> <output.smog>\n", argv[0]);
+        return 1;
+    }
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st_in) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        close(fd);
+        return 1;
+    }
+
+    memset(&packer, 0, sizeof(Packer));
+    packer.writer = create_game_pack_writer(out);
+    packer.moves_size = 512;
+    packer.moves = malloc(packer.moves_size * sizeof(uint16_t));
+
+    reader = create_game_reader(&callbacks);
+    result = game_reader_parse_fd(reader, fd);
+    game_reader_finish(reader);
+    destroy_game_reader(reader);
+    close(fd);
+
+    if (!close_game_pack_writer(packer.writer) || result < 0
+        || fstat(fileno(out), &st_out) < 0) {
+        perror(argv[2]);
+        fclose(out);
+        free(packer.moves);
+        return 1;
+    }
+    fclose(out);
+    free(packer.moves);
+
+    printf("Packed %llu moves in %llu games (%llu game(s) with illegal moves left out).\n",
+        packer.n_moves, packer.n_games, packer.n_illegal_games);
+    printf("%.2f MB -> %.2f MB (%.1f%% of the text, %.2f bytes per move).\n",
+        st_in.st_size / 1e6, st_out.st_size / 1e6,
+        st_in.st_size ? 100.0 * st_out.st_size / st_in.st_size : 0.0,
+        packer.n_moves ? (double)st_out.st_size / packer.n_moves : 0.0);
+    return 0;
+}
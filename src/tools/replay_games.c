@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitboard.h"
+#include "gamereader.h"
+#include "gamepack.h"
+
+/*
+ * Replays all the games of a packed game file, and optionally the same games
+ * from the text they came from, to compare the two.
+ *
+ * usage: replay_games [-g <game>] <games.smog> [games.whalg]
+ *
+ * With -g only that game is replayed (random access), and its final position
+ * is printed.
+ */
+
+typedef struct {
+    unsigned long long n_games;
+    unsigned long long n_moves;
+    U64 checksum;               /* of final positions, same for both paths */
+} ReplayStats;
+
+void count_game(GameInfo *info, void *user_data)
+{
+    ReplayStats *s = (ReplayStats *)user_data;
+    if (info->illegal || !info->n_moves) return;
+    s->n_games++;
+    s->n_moves += info->n_moves;
+}
+
+int hash_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    ((ReplayStats *)user_data)->checksum += b->hash;
+    return 1;
+}
+
+int print_final_position(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    if (info->n_moves == *(unsigned int *)user_data) print_chessboard(b);
+    return 1;
+}
+
+int skip_illegal_game(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    return 1;
+}
+
+double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void print_stats(const char *path, ReplayStats *s, double seconds)
+{
+    printf("%s: %llu moves in %llu games, %.3f s (%.0f moves/s), checksum %016llx\n",
+        path, s->n_moves, s->n_games, seconds,
+        seconds > 0 ? s->n_moves / seconds : 0.0, s->checksum);
+}
+
+int main(int argc, char **argv)
+{
+    const char *pack_filename = NULL, *text_filename = NULL;
+    long long game = -1;
+    ReplayStats pack_stats, text_stats;
+    GameReaderCallbacks callbacks;
+    GameReader *reader;
+    GamePack *pack;
+    struct timespec start;
+    double pack_seconds, text_seconds;
+    int fd, i;
+
+    for (i=1; i<argc; i++) {
+        if (!strcmp(argv[i], "-g") && i + 1 < argc) game = atoll(argv[++i]);
+        else if (!pack_filename) pack_filename = argv[i];
+        else text_filename = argv[i];
+    }
+    if (!pack_filename) {
+        fprintf(stderr, "usage: %s [-g <game>] <games.smog> [games.whalg]\n", argv[0]);
+        return 1;
+    }
+
+    fd = open(pack_filename, O_RDONLY);
+    pack = (fd < 0) ? NULL : open_game_pack(fd);
+    if (!pack) {
+        fprintf(stderr, "%s: not a packed game file\n", pack_filename);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    close(fd);
+
+    if (game >= 0) {
+        const PackedGame *g = game_pack_get(pack, game);
+        unsigned int n_moves;
+        if (!g) {
+            fprintf(stderr, "no game %lld, the file has %llu\n", game,
+                game_pack_count(pack));
+            close_game_pack(pack);
+            return 1;
+        }
+        n_moves = g->n_moves;
+        printf("Game %lld: %u moves, result %d, Elo %d/%d, ECO %.3s\n", game,
+            g->n_moves, g->result, g->white_elo, g->black_elo, g->eco);
+
+        memset(&callbacks, 0, sizeof(GameReaderCallbacks));
+        callbacks.on_move = print_final_position;
+        callbacks.user_data = &n_moves;
+        reader = create_game_reader(&callbacks);
+        game_reader_replay_pack(reader, pack, game, 1);
+        destroy_game_reader(reader);
+        close_game_pack(pack);
+        return 0;
+    }
+
+    memset(&callbacks, 0, sizeof(GameReaderCallbacks));
+    callbacks.on_move = hash_move;
+    callbacks.on_illegal_move = skip_illegal_game;
+    callbacks.on_game_end = count_game;
+
+    memset(&pack_stats, 0, sizeof(ReplayStats));
+    callbacks.user_data = &pack_stats;
+    reader = create_game_reader(&callbacks);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    game_reader_replay_pack(reader, pack, 0, game_pack_count(pack));
+    pack_seconds = elapsed_seconds(&start);
+    destroy_game_reader(reader);
+    close_game_pack(pack);
+    print_stats(pack_filename, &pack_stats, pack_seconds);
+
+    if (text_filename) {
+        fd = open(text_filename, O_RDONLY);
+        if (fd < 0) {
+            perror(text_filename);
+            return 1;
+        }
+        memset(&text_stats, 0, sizeof(ReplayStats));
+        callbacks.user_data = &text_stats;
+        reader = create_game_reader(&callbacks);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        game_reader_parse_fd(reader, fd);
+        game_reader_finish(reader);
+        text_seconds = elapsed_seconds(&start);
+        destroy_game_reader(reader);
+        close(fd);
+        print_stats(text_filename, &text_stats, text_seconds);
+
+        printf("Packed replay is %.1fx faster%s.\n",
+            pack_seconds > 0 ? text_seconds / pack_seconds : 0.0,
+            text_stats.checksum == pack_stats.checksum
+                ? "" : ", BUT THE GAMES DIFFER");
+    }
+    return 0;
+}
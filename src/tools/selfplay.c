@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "gamereader.h"
+#include "gamepack.h"
+
+/*
+ * Self-play match between two engine configurations, A (the base) and B (the
+ * candidate), stopped by a sequential probability ratio test.
+ *
+ * usage: selfplay [-A <config>] [-B <config>] [-n <nodes per move>]
+ *                 [-g <max games>] [-j <workers>] [-o <openings.whalg>]
+ *                 [-p <opening plies>] [-e <elo0>,<elo1>] [-H <hash MB>]
+ *
+ * A config is a comma separated list of key=value, with the eval weights
+ * (material, piece_count, center_occupation, center_attackers,
+ * mobility_knight, mobility_bishop, mobility_rook, mobility_queen,
+ * king_zone_attacks) and the search limits (nodes, depth), e.g.
+ * "center_attackers=0.3,nodes=5000".
+ *
+ * Openings are the first plies of games sampled from the openings file, each
+ * played twice with colors swapped. Every search is node limited and seeded
+ * from the game number and ply, with fresh tables each game, so a game is
+ * the same whatever the number of workers. Results are counted in game
+ * number order, so are the reports and the stop decision.
+ *
+ * The test is H0: elo(B - A) <= elo0 against H1: elo(B - A) >= elo1, with
+ * alpha = beta = 0.05.
+ */
+
+#define SELFPLAY_MAX_OPENING_PLIES 32
+#define SELFPLAY_MAX_GAME_PLIES 300
+#define SELFPLAY_DEFAULT_NODES 2000
+#define SELFPLAY_DEFAULT_GAMES 10000
+#define SELFPLAY_DEFAULT_PLIES 8
+#define SELFPLAY_DEFAULT_HASH_MB 4
+#define SELFPLAY_SPRT_ALPHA 0.05
+#define SELFPLAY_SPRT_BETA 0.05
+#define SELFPLAY_REPORT_INTERVAL 100
+
+typedef struct {
+    EvalWeights weights;
+    unsigned long long nodes;
+    int depth;
+} EngineConfig;
+
+typedef struct {
+    uint16_t moves[SELFPLAY_MAX_OPENING_PLIES];
+} Opening;
+
+typedef struct {
+    EngineConfig engines[2];    /* A, B */
+    Opening *openings;
+    int n_openings;
+    int opening_plies;
+    unsigned int hash_mb;
+    int max_games;
+    double elo0, elo1;
+
+    volatile int next_game;
+    volatile int stop;
+
+    /*
+     * Results for B, under the lock. Games finished ahead of an earlier one
+     * wait in done (b_score + 2, 0 while not finished, by game number) until
+     * the first n_games are all there.
+     */
+    pthread_mutex_t lock;
+    signed char *done;
+    int wins, draws, losses;
+    int n_games;
+} Match;
+
+/* - - - - - - - - - - OPENINGS - - - - - - - - - - */
+
+typedef struct {
+    Opening *openings;
+    int n_openings;
+    int size;
+    int plies;
+} OpeningBook;
+
+int collect_opening_move(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    OpeningBook *book = (OpeningBook *)user_data;
+
+    if (info->n_moves == 1) {
+        if (book->n_openings == book->size) {
+            book->size *= 2;
+            book->openings = realloc(book->openings, book->size * sizeof(Opening));
+        }
+    }
+    if (info->n_moves <= (unsigned int)book->plies) {
+        book->openings[book->n_openings].moves[info->n_moves - 1] =
+            game_pack_encode_move(m);
+    }
+    return 1;
+}
+
+int skip_illegal_game(GameInfo *info, Bitboard *b, Move *m, void *user_data)
+{
+    return 1;
+}
+
+void keep_opening(GameInfo *info, void *user_data)
+{
+    OpeningBook *book = (OpeningBook *)user_data;
+    if (!info->illegal && info->n_moves >= (unsigned int)book->plies) {
+        book->n_openings++;
+    }
+}
+
+int load_openings(Match *match, const char *filename, unsigned int seed)
+{
+    OpeningBook book;
+    GameReaderCallbacks callbacks = {
+        NULL, collect_opening_move, skip_illegal_game, keep_opening, &book
+    };
+    GameReader *reader;
+    int fd = open(filename, O_RDONLY), i;
+
+    if (fd < 0) {
+        perror(filename);
+        return 0;
+    }
+    book.size = 1024;
+    book.n_openings = 0;
+    book.plies = match->opening_plies;
+    book.openings = malloc(book.size * sizeof(Opening));
+
+    reader = create_game_reader(&callbacks);
+    game_reader_parse_fd(reader, fd);
+    game_reader_finish(reader);
+    destroy_game_reader(reader);
+    close(fd);
+
+    /* sampled by shuffling them */
+    for (i=book.n_openings - 1; i>0; i--) {
+        int j = rand_r(&seed) % (i + 1);
+        Opening tmp = book.openings[i];
+        book.openings[i] = book.openings[j];
+        book.openings[j] = tmp;
+    }
+
+    match->openings = book.openings;
+    match->n_openings = book.n_openings;
+    return book.n_openings > 0;
+}
+
+/* - - - - - - - - - - GAMES - - - - - - - - - - */
+
+int is_repetition(U64 *keys, int n_keys)
+{
+    int i, count = 1;
+    for (i=n_keys - 3; i>=0; i-=2) {
+        if (keys[i] == keys[n_keys - 1] && ++count == 3) return 1;
+    }
+    return 0;
+}
+
+/* 1 if white wins, -1 if black wins, 0 for draws */
+int play_game(Match *match, int game, TranspositionTable **tts)
+{
+    Opening *opening = &(match->openings[(game / 2) % match->n_openings]);
+    int white = game % 2;       /* engine playing white: A, then B */
+    U64 keys[SELFPLAY_MAX_GAME_PLIES + 1];
+    SearchOptions options;
+    SearchResult result;
+    Bitboard *b = bitboard_from_fen(FEN_INITIAL_POSITION);
+    int ply, outcome = 0;
+    Move m;
+
+    clear_transposition_table(tts[0]);
+    clear_transposition_table(tts[1]);
+
+    for (ply=0; ply<match->opening_plies; ply++) {
+        game_pack_decode_move(opening->moves[ply], !(ply & 1), &m);
+        bitboard_do_move(b, &m);
+    }
+
+    keys[0] = bitboard_key(b, b->turn);
+    for (ply=0; ply<SELFPLAY_MAX_GAME_PLIES; ply++) {
+        int engine = (b->turn == PIECE_COLOR_WHITE) ? white : !white;
+        EngineConfig *config = &(match->engines[engine]);
+
+        if (!bitboard_has_legal_move(b, b->turn)) {
+            if (bitboard_is_in_check(b, b->turn)) outcome = (b->turn == PIECE_COLOR_WHITE) ? -1 : 1;
+            break;
+        }
+        if (b->halfmove_clock >= 100 || is_repetition(keys, ply + 1)
+            || bitboard_get_white_count(b) + bitboard_get_black_count(b) == 2) {
+            break;
+        }
+
+        init_search_options(&options);
+        options.nodes = config->nodes;
+        options.depth = config->depth;
+        options.weights = &(config->weights);
+        options.tt = tts[engine];
+        options.seed = (unsigned int)game * SELFPLAY_MAX_GAME_PLIES + ply + 1;
+        options.history = keys;
+        options.history_length = ply;
+        engine_search(b, b->turn, &options, &result);
+
+        bitboard_do_move(b, &(result.best_move));
+        keys[ply + 1] = bitboard_key(b, b->turn);
+    }
+
+    destroy_bitboard(b);
+    return outcome;
+}
+
+/* - - - - - - - - - - SPRT - - - - - - - - - - */
+
+double expected_score(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+double score_to_elo(double score)
+{
+    if (score <= 0.0) return -INFINITY;
+    if (score >= 1.0) return INFINITY;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+/*
+ * Log-likelihood ratio of H1 against H0, with the normal approximation of
+ * the distribution of game scores.
+ */
+double sprt_llr(int wins, int draws, int losses, double elo0, double elo1,
+    double *score, double *stddev)
+{
+    int n = wins + draws + losses;
+    double s, var, s0 = expected_score(elo0), s1 = expected_score(elo1);
+
+    *score = 0.5;
+    *stddev = 0.0;
+    if (!n) return 0.0;
+
+    s = (wins + 0.5 * draws) / n;
+    var = (wins * (1.0 - s) * (1.0 - s) + draws * (0.5 - s) * (0.5 - s)
+        + losses * s * s) / n;
+    *score = s;
+    *stddev = sqrt(var / n);
+    if (var <= 0.0) return 0.0;
+    return n * (s1 - s0) * (2.0 * s - s0 - s1) / (2.0 * var);
+}
+
+void report(Match *match, int final)
+{
+    double lower = log(SELFPLAY_SPRT_BETA / (1.0 - SELFPLAY_SPRT_ALPHA));
+    double upper = log((1.0 - SELFPLAY_SPRT_BETA) / SELFPLAY_SPRT_ALPHA);
+    double score, stddev;
+    double llr = sprt_llr(match->wins, match->draws, match->losses,
+        match->elo0, match->elo1, &score, &stddev);
+
+    printf("Games %d: B +%d =%d -%d, Elo %.1f [%.1f, %.1f], LLR %.2f [%.2f, %.2f]\n",
+        match->n_games, match->wins, match->draws, match->losses,
+        score_to_elo(score), score_to_elo(score - 1.96 * stddev),
+        score_to_elo(score + 1.96 * stddev), llr, lower, upper);
+
+    if (final) {
+        if (llr >= upper) printf("H1 accepted: B is stronger than A by %.1f Elo or more.\n", match->elo1);
+        else if (llr <= lower) printf("H0 accepted: B is not stronger than A by more than %.1f Elo.\n", match->elo0);
+        else printf("Inconclusive after %d games.\n", match->n_games);
+    }
+    fflush(stdout);
+}
+
+/*
+ * Called with the lock held. Counts the finished games following the ones
+ * already counted, up to the first still running, and stops the match on the
+ * first of them ending the test: games after it are never counted.
+ */
+void add_result(Match *match, int game, int b_score)
+{
+    double lower = log(SELFPLAY_SPRT_BETA / (1.0 - SELFPLAY_SPRT_ALPHA));
+    double upper = log((1.0 - SELFPLAY_SPRT_BETA) / SELFPLAY_SPRT_ALPHA);
+    double score, stddev, llr;
+
+    match->done[game] = b_score + 2;
+    while (!match->stop && match->n_games < match->max_games
+            && match->done[match->n_games]) {
+        b_score = match->done[match->n_games] - 2;
+        if (b_score > 0) match->wins++;
+        else if (b_score < 0) match->losses++;
+        else match->draws++;
+        match->n_games++;
+
+        llr = sprt_llr(match->wins, match->draws, match->losses,
+            match->elo0, match->elo1, &score, &stddev);
+        if (llr >= upper || llr <= lower) match->stop = 1;
+        if (match->n_games % SELFPLAY_REPORT_INTERVAL == 0) report(match, 0);
+    }
+}
+
+void *match_worker(void *arg)
+{
+    Match *match = (Match *)arg;
+    TranspositionTable *tts[2];
+    int game;
+
+    tts[0] = create_transposition_table(match->hash_mb);
+    tts[1] = create_transposition_table(match->hash_mb);
+
+    while (!match->stop
+        && (game = __sync_fetch_and_add(&(match->next_game), 1)) < match->max_games) {
+        int outcome = play_game(match, game, tts);
+
+        /* B plays white in odd games */
+        pthread_mutex_lock(&(match->lock));
+        add_result(match, game, (game % 2) ? outcome : -outcome);
+        pthread_mutex_unlock(&(match->lock));
+    }
+
+    destroy_transposition_table(tts[0]);
+    destroy_transposition_table(tts[1]);
+    return NULL;
+}
+
+/* - - - - - - - - - - OPTIONS - - - - - - - - - - */
+
+int parse_config(char *spec, EngineConfig *config)
+{
+    char *item, *save;
+
+    for (item = strtok_r(spec, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(item, '=');
+        if (!value) return 0;
+        *(value++) = '\0';
+
+        if (!strcmp(item, "material")) config->weights.material = atof(value);
+        else if (!strcmp(item, "piece_count")) config->weights.piece_count = atof(value);
+        else if (!strcmp(item, "center_occupation")) config->weights.center_occupation = atof(value);
+        else if (!strcmp(item, "center_attackers")) config->weights.center_attackers = atof(value);
+        else if (!strcmp(item, "mobility_knight")) config->weights.mobility_knight = atof(value);
+        else if (!strcmp(item, "mobility_bishop")) config->weights.mobility_bishop = atof(value);
+        else if (!strcmp(item, "mobility_rook")) config->weights.mobility_rook = atof(value);
+        else if (!strcmp(item, "mobility_queen")) config->weights.mobility_queen = atof(value);
+        else if (!strcmp(item, "king_zone_attacks")) config->weights.king_zone_attacks = atof(value);
+        else if (!strcmp(item, "nodes")) config->nodes = strtoull(value, NULL, 10);
+        else if (!strcmp(item, "depth")) config->depth = atoi(value);
+        else return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *openings_filename = "games/Adams.whalg";
+    unsigned long long nodes = SELFPLAY_DEFAULT_NODES;
+    char *specs[2] = { NULL, NULL };
+    int n_workers = 1, i;
+    pthread_t *workers;
+    Match match;
+
+    memset(&match, 0, sizeof(Match));
+    pthread_mutex_init(&(match.lock), NULL);
+    match.max_games = SELFPLAY_DEFAULT_GAMES;
+    match.opening_plies = SELFPLAY_DEFAULT_PLIES;
+    match.hash_mb = SELFPLAY_DEFAULT_HASH_MB;
+    match.elo0 = 0.0;
+    match.elo1 = 10.0;
+
+    for (i=1; i<argc; i++) {
+        int has_value = i + 1 < argc;
+        if (!has_value) break;
+        if (!strcmp(argv[i], "-A")) specs[0] = argv[++i];
+        else if (!strcmp(argv[i], "-B")) specs[1] = argv[++i];
+        else if (!strcmp(argv[i], "-n")) nodes = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-g")) match.max_games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o")) openings_filename = argv[++i];
+        else if (!strcmp(argv[i], "-p")) match.opening_plies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-H")) match.hash_mb = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e")) sscanf(argv[++i], "%lf,%lf", &match.elo0, &match.elo1);
+        else if (!strcmp(argv[i], "-j")) {
+            n_workers = atoi(argv[++i]);
+            if (n_workers <= 0) n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else break;
+    }
+    if (i < argc) {
+        fprintf(stderr, "usage: %s [-A <config>] [-B <config>] [-n <nodes per move>] "
+            "[-g <max games>] [-j <workers>] [-o <openings.whalg>] [-p <opening plies>] "
+            "[-e <elo0>,<elo1>] [-H <hash MB>]\n", argv[0]);
+        return 1;
+    }
+    if (match.opening_plies < 0) match.opening_plies = 0;
+    if (match.opening_plies > SELFPLAY_MAX_OPENING_PLIES) {
+        match.opening_plies = SELFPLAY_MAX_OPENING_PLIES;
+    }
+
+    for (i=0; i<2; i++) {
+        init_eval_weights(&(match.engines[i].weights));
+        match.engines[i].nodes = nodes;
+        if (specs[i] && !parse_config(specs[i], &(match.engines[i]))) {
+            fprintf(stderr, "bad config for engine %c\n", 'A' + i);
+            return 1;
+        }
+    }
+
+    if (!load_openings(&match, openings_filename, 1)) {
+        fprintf(stderr, "%s: no openings of %d plies\n", openings_filename,
+            match.opening_plies);
+        return 1;
+    }
+    printf("%d openings of %d plies, up to %d games on %d worker(s), "
+        "SPRT elo0 %.1f elo1 %.1f\n", match.n_openings, match.opening_plies,
+        match.max_games, n_workers, match.elo0, match.elo1);
+
+    match.done = calloc(match.max_games > 0 ? match.max_games : 1, 1);
+    workers = malloc(n_workers * sizeof(pthread_t));
+    for (i=0; i<n_workers; i++) {
+        pthread_create(&(workers[i]), NULL, match_worker, &match);
+    }
+    for (i=0; i<n_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    report(&match, 1);
+
+    free(workers);
+    free(match.done);
+    free(match.openings);
+    pthread_mutex_destroy(&(match.lock));
+    return 0;
+}
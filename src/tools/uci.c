@@ -0,0 +1,533 @@
+/*
+ * UCI front-end to the engine.
+ *
+ * Commands are read on their own thread: stop, ponderhit and quit are
+ * handled there right away, while a search may be running on the main
+ * thread, and so is isready during a search. All other commands are queued
+ * for the main thread.
+ *
+ * Besides the UCI commands, "profile" writes the cycle counters of the
+ * engine (see profile.h) as info strings, and "profile reset" clears them.
+ * With "debug on", they are written and cleared after every search.
+ *
+ * "bench [depth]" (also as "smoengine-uci bench [depth]") searches a fixed
+ * set of positions, see cmd_bench.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "profile.h"
+
+#define UCI_LINE_SIZE 8192
+#define UCI_DEFAULT_MOVES_TO_GO 30
+#define UCI_MOVE_OVERHEAD 50
+#define UCI_BENCH_DEPTH 4
+#define UCI_BENCH_SEED 1
+
+/* - - - - - - - - - - POSITION - - - - - - - - - - */
+
+Bitboard *board = NULL;
+PieceColor turn = PIECE_COLOR_WHITE;
+
+/* keys of the positions before board, for repetitions */
+U64 *history = NULL;
+int history_length = 0;
+
+/* position [startpos | fen <fen>] [moves <move> ...] */
+void cmd_position(char **tokens, int n_tokens)
+{
+    int i = 1;
+    Move m;
+
+    if (board) destroy_bitboard(board);
+    board = NULL;
+
+    if (i < n_tokens && !strcmp(tokens[i], "fen")) {
+        char fen[UCI_LINE_SIZE];
+        int len = 0;
+
+        /* the FEN fields were split into tokens */
+        for (i++; i < n_tokens && strcmp(tokens[i], "moves"); i++) {
+            len += snprintf(fen + len, sizeof(fen) - len, len ? " %s" : "%s", tokens[i]);
+            if (len >= (int)sizeof(fen)) break;
+        }
+        board = bitboard_from_fen(fen);
+    }
+    else if (i < n_tokens && !strcmp(tokens[i], "startpos")) {
+        i++;
+    }
+    if (!board) board = bitboard_from_fen(FEN_INITIAL_POSITION);
+    turn = board->turn;
+
+    history_length = 0;
+    if (i < n_tokens && !strcmp(tokens[i], "moves")) {
+        history = realloc(history, (n_tokens - i) * sizeof(U64));
+        for (i++; i < n_tokens; i++) {
+            if (!move_from_string(board, tokens[i], &m)
+                || !is_legal_move(board, &m)) {
+                break;
+            }
+            history[history_length++] = bitboard_key(board, board->turn);
+            bitboard_do_move(board, &m);
+        }
+        turn = board->turn;
+    }
+}
+
+/* - - - - - - - - - - OUTPUT - - - - - - - - - - */
+
+pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void uci_send(const char *fmt, ...)
+{
+    va_list args;
+    pthread_mutex_lock(&output_lock);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+    pthread_mutex_unlock(&output_lock);
+}
+
+void send_profile()
+{
+    pthread_mutex_lock(&output_lock);
+    profile_dump(stdout, "info string ");
+    pthread_mutex_unlock(&output_lock);
+}
+
+void send_info(SearchResult *result)
+{
+    char line[UCI_LINE_SIZE];
+    char move[6];
+    int i, len, mate_in;
+    long nps = result->time_ms ? result->nodes * 1000 / result->time_ms : 0;
+
+    mate_in = engine_mate_in(result->score);
+    if (mate_in) {
+        len = sprintf(line, "info depth %d score mate %d", result->depth, mate_in);
+    }
+    else {
+        len = sprintf(line, "info depth %d score cp %d", result->depth, (int)result->score);
+    }
+    len += sprintf(line + len, " nodes %llu nps %ld time %ld pv",
+        result->nodes, nps, result->time_ms);
+
+    for (i=0; i<result->pv_length && len < UCI_LINE_SIZE - 8; i++) {
+        move_to_string(&(result->pv[i]), move);
+        len += sprintf(line + len, " %s", move);
+    }
+    uci_send("%s", line);
+}
+
+/* - - - - - - - - - - SEARCH - - - - - - - - - - */
+
+pthread_mutex_t search_lock = PTHREAD_MUTEX_INITIALIZER;
+Search *current_search = NULL;
+/* go commands queued but not started, and what to do with them once started */
+int pending_go = 0;
+int pending_stop = 0;
+int pending_ponderhit = 0;
+int threads = 1;
+int debug = 0;
+
+/* go [ponder] [wtime|btime|winc|binc|movestogo|movetime|depth|nodes <n>] [infinite] */
+void cmd_go(char **tokens, int n_tokens)
+{
+    SearchOptions options;
+    SearchResult result;
+    Search *s;
+    long time_left = 0, increment = 0, moves_to_go = UCI_DEFAULT_MOVES_TO_GO;
+    int i, ponder = 0;
+    char move[6], ponder_move[6];
+
+    if (!board) {
+        board = bitboard_from_fen(FEN_INITIAL_POSITION);
+        turn = board->turn;
+    }
+
+    init_search_options(&options);
+    options.threads = threads;
+    options.callback_iteration = send_info;
+    options.history = history;
+    options.history_length = history_length;
+
+    for (i=1; i<n_tokens; i++) {
+        int has_value = i + 1 < n_tokens;
+        if (!strcmp(tokens[i], "infinite")) options.infinite = 1;
+        else if (!strcmp(tokens[i], "ponder")) ponder = 1;
+        else if (!has_value) break;
+        else if (!strcmp(tokens[i], "movetime")) options.movetime = atol(tokens[++i]);
+        else if (!strcmp(tokens[i], "depth")) options.depth = atoi(tokens[++i]);
+        else if (!strcmp(tokens[i], "nodes")) options.nodes = strtoull(tokens[++i], NULL, 10);
+        else if (!strcmp(tokens[i], "movestogo")) moves_to_go = atol(tokens[++i]);
+        else if (!strcmp(tokens[i], "wtime")) {
+            i++;
+            if (turn == PIECE_COLOR_WHITE) time_left = atol(tokens[i]);
+        }
+        else if (!strcmp(tokens[i], "btime")) {
+            i++;
+            if (turn == PIECE_COLOR_BLACK) time_left = atol(tokens[i]);
+        }
+        else if (!strcmp(tokens[i], "winc")) {
+            i++;
+            if (turn == PIECE_COLOR_WHITE) increment = atol(tokens[i]);
+        }
+        else if (!strcmp(tokens[i], "binc")) {
+            i++;
+            if (turn == PIECE_COLOR_BLACK) increment = atol(tokens[i]);
+        }
+    }
+
+    /* share the clock among the moves to go, never flag */
+    if (time_left && !options.movetime) {
+        options.movetime = time_left / (moves_to_go > 0 ? moves_to_go : 1)
+            + increment / 2;
+        if (options.movetime > time_left - UCI_MOVE_OVERHEAD) {
+            options.movetime = time_left - UCI_MOVE_OVERHEAD;
+        }
+        if (options.movetime < 1) options.movetime = 1;
+    }
+
+    s = engine_search_start(board, turn, &options, ponder);
+
+    /* stop and ponderhit may have been read before the search started */
+    pthread_mutex_lock(&search_lock);
+    current_search = s;
+    if (pending_go > 0) pending_go--;
+    if (s && pending_ponderhit) engine_search_ponderhit(s);
+    if (s && pending_stop) engine_search_stop(s);
+    pending_stop = pending_ponderhit = 0;
+    pthread_mutex_unlock(&search_lock);
+
+    if (!s) {
+        uci_send("bestmove 0000");
+        return;
+    }
+
+    engine_search_wait(s, &result);
+
+    pthread_mutex_lock(&search_lock);
+    current_search = NULL;
+    pthread_mutex_unlock(&search_lock);
+    destroy_search(s);
+
+    if (debug && profile_enabled()) {
+        send_profile();
+        profile_reset();
+    }
+
+    if (result.best_move.is_checkmate || result.is_stalemate) {
+        uci_send("bestmove 0000");
+        return;
+    }
+
+    move_to_string(&(result.best_move), move);
+    if (result.has_ponder_move) {
+        move_to_string(&(result.ponder_move), ponder_move);
+        uci_send("bestmove %s ponder %s", move, ponder_move);
+    }
+    else {
+        uci_send("bestmove %s", move);
+    }
+}
+
+/* setoption name <name> value <value> */
+void cmd_setoption(char **tokens, int n_tokens)
+{
+    if (n_tokens < 5 || strcmp(tokens[1], "name") || strcmp(tokens[3], "value")) {
+        return;
+    }
+    if (!strcmp(tokens[2], "Hash")) {
+        int size_mb = atoi(tokens[4]);
+        if (size_mb > 0) engine_set_hash_size(size_mb);
+    }
+    else if (!strcmp(tokens[2], "Threads")) {
+        threads = atoi(tokens[4]);
+        if (threads < 1) threads = 1;
+    }
+}
+
+/* - - - - - - - - - - BENCH - - - - - - - - - - */
+
+/* the initial position, then positions from games/Adams.whalg */
+const char *bench_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pp1n1ppp/2n1p3/2ppP3/3P1P2/2P5/PP1N2PP/R1BQKBNR w KQkq - 1 7",
+    "2rq1rk1/p3bp1p/bpn1p1p1/1P6/3P4/P1BQ1N2/2B2PPP/R3R1K1 b - - 0 17",
+    "2k5/1b2b3/1B1ppp2/PB2n1p1/4Pn2/1P3P1r/2PR3P/1K3R2 w - - 1 28",
+    "r2q1rk1/2pn1pbp/p1pp2p1/8/Q1P1P3/2N1BP2/PP4PP/R4RK1 b - - 2 14",
+    "5rk1/6pp/p7/1p4q1/1n1N4/RP5P/1P3PP1/1Q4K1 w - - 0 25",
+    "r2q1rk1/2p1bppp/p2p1n2/np1Pp3/4P1b1/2P2N2/PPB2PPP/RNBQR1K1 b - - 2 11",
+    "r5k1/1bpqr2p/3p2p1/p1pP1p1n/2P5/P1Q2N2/1P3PPP/3RRBK1 w - - 4 22",
+    "rn1q1rk1/pbpp1ppp/1p2pn2/6B1/2PP4/P1Q2P2/1P2P1PP/R3KBNR b KQ f3 0 8",
+    "3rk2r/p3bppp/qnp5/3nPP2/1p6/1N1p1N2/PP4PP/R1B1QR1K w k - 4 19",
+    "2r2b2/1k1r1pp1/p3p2p/1p2P3/8/P1P1B1P1/1PK4P/3RR3 b - - 2 29",
+    "r1br2k1/1pq2pNp/p3pn2/8/8/1B6/PPP2PPb/R1BQR2K w - - 1 16",
+    "r2r4/4kp1p/2p3p1/p1P2p2/PnB5/4P1P1/1P2KP1P/2RR4 b - g3 0 26",
+    "r2qnrk1/1b1nbppp/pp1pp3/8/2P2B2/2N2NP1/PP1QPPBP/R2R2K1 w - - 6 13",
+    "2br1rk1/2q2ppp/p1np4/2p1p3/2P1P3/PPN3P1/1Q3PBP/3RR1K1 b - - 2 23",
+    "rn1q1rk1/1pp1bppp/p1b1pn2/4N3/P1pP4/6P1/1PQ1PPBP/RNB2RK1 w - - 3 10",
+    "2r1rnk1/pp1b1ppp/4p3/4q1B1/2P5/8/PPBQ1PPP/2RR2K1 b - - 4 20",
+    "rnbq1rk1/pp3ppp/2pb1p2/3p4/3P4/4P1P1/PPPN1P1P/R2QKBNR w KQ - 2 7",
+    "r3kb1r/p1q2p1p/1pb1p1p1/3pP3/3B1P2/P4R2/1PPQ2PP/R2N2K1 b kq - 1 17",
+    "5rk1/5pp1/1p5p/p1bPp1q1/4B3/2Q1P3/PP4PP/5RK1 w - - 5 28",
+    "r2qk2r/pp4pp/1n2p3/2b5/3n4/2N1BP2/PP3PBP/R2QK2R b KQkq - 3 14",
+    "2k3r1/q4p1p/2p1b1r1/1p2p3/1B2P1n1/1P1B1R1P/P1P3P1/R3Q2K w - - 1 25",
+    "r2qk2r/pp1nbppp/4p3/2ppPn2/3Pb1P1/2P2N2/PP1NBP1P/R1BQ1RK1 b kq g3 0 11",
+    "4r1k1/p2rn1b1/Ppppq1pp/3Np3/2P1P2N/R7/1PP2PP1/3QR1K1 w - c6 0 22",
+    "r1bqk2r/p1pp1ppp/1Bp2n2/8/4P3/2N5/PPP2PPP/R2QKB1R b KQkq - 0 8",
+    "1r1q1r1k/4n1bp/3p2p1/ppp2p2/5P2/P2PB1PP/1PP3B1/1R1QR1K1 w - - 0 19",
+    "r2q1rk1/p4pp1/b2pp1np/2p4n/2P5/P1Q1P1B1/1PBN1PPP/R3K2R w KQ - 6 16",
+    "r5k1/2pn1ppp/3p4/2b5/3PP3/4B2P/5PP1/3R1NK1 b - - 0 26",
+    "r2qr1k1/1pp2pp1/p1npbn1p/4p3/4P3/1BPPbN1P/PP3PP1/R2QRNK1 w - - 0 13",
+    "5rk1/pp1q1pp1/1r6/3pR2p/3P2nP/P1NK2Q1/1PP3P1/4R3 b - - 3 23",
+    "rn2kb1r/1bq2ppp/p2ppn2/1p6/3NP1P1/P1N1B3/1PP1BP1P/R2QK2R w KQkq - 1 10",
+    "r3k1r1/2p1pp2/p2q1n1b/1p1p1PNp/3P3P/4QB2/PPP3P1/1K2R2R b q - 3 20",
+    "r1bqk2r/2ppbppp/p1n2n2/1p2p3/B3P3/5N2/PPPP1PPP/RNBQR1K1 w kq b6 0 7",
+    "r1b1r1k1/1pqn1pp1/p2b3p/P3p3/2B1Q3/1P3N2/2P2PPP/R1B1R1K1 b - - 0 17",
+    "r2q1rk1/p3bppp/2n2n2/2pp1P2/Np6/6P1/PPP2PBP/R1BQR1K1 b - - 1 14",
+    "r1n1rbk1/3bqpnp/p2p2pB/P1pP4/1pP1PQP1/1P5P/2B4N/R3RNK1 w - - 1 25",
+    "r1b1r3/pp1nkpp1/1qpb3p/3pp3/3P4/2P1PN2/PP1NBPPP/R1Q2RK1 b - - 3 11",
+    "rqr3k1/4bppp/3pb3/pNn1p3/P3P3/1PB3P1/3Q1PBP/RR4K1 w - - 3 22",
+    "r2qk2r/1pp1bppp/p1np1n2/4p3/B3P1b1/2PP1N2/PP3PPP/RNBQR1K1 b kq d3 0 8",
+    "r2b1rk1/pb3p1p/4p1p1/1pq3B1/7Q/3B4/PPP2PPP/R2R2K1 w - - 2 19",
+    "7r/rb3k1p/1p1Rp1p1/p4p2/P4P2/2P3P1/1P2B2P/1K1R4 b - g3 0 29",
+    "1r2r1k1/1ppq1pp1/p1np1n1p/4p3/4P3/1QPPNN1P/PP3PP1/3RR1K1 w - - 3 16",
+    "1r4k1/3nbpp1/B2p1n1p/B1rP4/4p3/2P1N2P/1q3PP1/R2RQ1K1 b - c3 0 26",
+    "r2qr1k1/1bp1bpp1/p1np1n1p/1p6/P2pP3/1BP2N1P/1P1N1PP1/R1BQR1K1 w - - 0 13",
+    "2k4r/ppp2p1p/6p1/8/7r/4B3/PP2KP1N/RN6 b - - 0 23",
+    "rnbq1rk1/2p1bppp/p2p1n2/1p2p3/4P3/1BP2N1P/PP1P1PP1/RNBQR1K1 w - - 1 10",
+    "r3rbk1/p4ppp/1p6/8/3P1N2/1P6/1P1R1PPP/5RK1 b - - 0 20",
+    "r1bqk2r/1pp1bppp/p1p2n2/4p3/4P3/5N2/PPPP1PPP/RNBQ1RK1 w kq d6 0 7",
+    "r1b1q1k1/1pb2pp1/p1n4p/3p4/3B4/2P2N1P/PPB2PP1/R2Q2K1 b - - 1 17",
+    "3r3r/pkp2p2/1p4p1/1bp1P1b1/6P1/1PB2PK1/PNP4R/R7 w - - 6 28",
+    NULL
+};
+
+/*
+ * bench [depth]: searches each bench position to a fixed depth, on one thread,
+ * with a fixed seed and a table of the default size cleared before each one.
+ * The total of the nodes is a signature of the search: it only changes when
+ * the search behaves differently. Time to depth is the mean over positions of
+ * the time taken by the iterations up to that depth.
+ */
+void cmd_bench(int depth)
+{
+    TranspositionTable *tt = create_transposition_table(ENGINE_DEFAULT_HASH_MB);
+    double time_to_depth[ENGINE_MAX_PLY];
+    unsigned long long total_nodes = 0;
+    long total_ms = 0;
+    SearchOptions options;
+    SearchResult result;
+    char move[6], line[UCI_LINE_SIZE];
+    int i, d, len, n_positions = 0;
+
+    if (depth < 1 || depth >= ENGINE_MAX_PLY) depth = UCI_BENCH_DEPTH;
+    memset(time_to_depth, 0, sizeof(time_to_depth));
+
+    init_search_options(&options);
+    options.depth = depth;
+    options.threads = 1;
+    options.seed = UCI_BENCH_SEED;
+    options.tt = tt;
+
+    for (i=0; bench_positions[i]; i++) {
+        Bitboard *b = bitboard_from_fen(bench_positions[i]);
+        long elapsed = 0;
+
+        clear_transposition_table(tt);
+        engine_search(b, b->turn, &options, &result);
+        destroy_bitboard(b);
+
+        for (d=1; d<=result.stats.depth; d++) {
+            elapsed += result.stats.depth_time_ms[d];
+            time_to_depth[d] += elapsed;
+        }
+        total_nodes += result.nodes;
+        total_ms += result.time_ms;
+        n_positions++;
+
+        move_to_string(&(result.best_move), move);
+        uci_send("info string bench position %d: depth %d nodes %llu time %ld bestmove %s",
+            i + 1, result.depth, result.nodes, result.time_ms, move);
+    }
+    destroy_transposition_table(tt);
+
+    len = sprintf(line, "info string bench time to depth (ms):");
+    for (d=1; d<=depth; d++) {
+        len += sprintf(line + len, " %d: %.1f", d, time_to_depth[d] / n_positions);
+    }
+    uci_send("%s", line);
+    uci_send("info string bench %d positions at depth %d", n_positions, depth);
+    uci_send("info string bench total time (ms): %ld", total_ms);
+    uci_send("info string bench nodes searched: %llu", total_nodes);
+    uci_send("info string bench nodes/second: %llu",
+        total_ms ? total_nodes * 1000 / total_ms : 0ULL);
+}
+
+/* - - - - - - - - - - INPUT - - - - - - - - - - */
+
+typedef struct command_t {
+    char line[UCI_LINE_SIZE];
+    struct command_t *next;
+} Command;
+
+pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+Command *queue_head = NULL;
+Command *queue_tail = NULL;
+
+void queue_push(const char *line)
+{
+    Command *c = malloc(sizeof(Command));
+    strncpy(c->line, line, UCI_LINE_SIZE - 1);
+    c->line[UCI_LINE_SIZE - 1] = '\0';
+    c->next = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_tail) queue_tail->next = c;
+    else queue_head = c;
+    queue_tail = c;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+Command *queue_pop()
+{
+    Command *c;
+    pthread_mutex_lock(&queue_lock);
+    while (!queue_head) {
+        pthread_cond_wait(&queue_not_empty, &queue_lock);
+    }
+    c = queue_head;
+    queue_head = c->next;
+    if (!queue_head) queue_tail = NULL;
+    pthread_mutex_unlock(&queue_lock);
+    return c;
+}
+
+/* commands that must act on the running search without waiting for it */
+void *input_thread(void *arg)
+{
+    char line[UCI_LINE_SIZE];
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        /* while searching, isready is answered at once, else in order */
+        if (!strcmp(line, "isready")) {
+            int searching;
+            pthread_mutex_lock(&search_lock);
+            searching = current_search || pending_go;
+            pthread_mutex_unlock(&search_lock);
+            if (searching) {
+                uci_send("readyok");
+                continue;
+            }
+        }
+        if (!strcmp(line, "stop") || !strcmp(line, "ponderhit")
+            || !strcmp(line, "quit")) {
+            pthread_mutex_lock(&search_lock);
+            if (current_search) {
+                if (!strcmp(line, "ponderhit")) engine_search_ponderhit(current_search);
+                else engine_search_stop(current_search);
+            }
+            else if (pending_go) {
+                if (!strcmp(line, "ponderhit")) pending_ponderhit = 1;
+                else pending_stop = 1;
+            }
+            pthread_mutex_unlock(&search_lock);
+            if (strcmp(line, "quit")) continue;
+        }
+        if (!strncmp(line, "go", 2) && (line[2] == ' ' || line[2] == '\0')) {
+            pthread_mutex_lock(&search_lock);
+            pending_go++;
+            pthread_mutex_unlock(&search_lock);
+        }
+        queue_push(line);
+    }
+    queue_push("quit");
+    return NULL;
+}
+
+int tokenize(char *line, char **tokens, int max_tokens)
+{
+    int n = 0;
+    char *token = strtok(line, " \t");
+    while (token && n < max_tokens) {
+        tokens[n++] = token;
+        token = strtok(NULL, " \t");
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t input;
+    char *tokens[UCI_LINE_SIZE / 2];
+    int n_tokens, quit = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        cmd_bench(argc > 2 ? atoi(argv[2]) : UCI_BENCH_DEPTH);
+        return 0;
+    }
+
+    pthread_create(&input, NULL, input_thread, NULL);
+
+    while (!quit) {
+        Command *c = queue_pop();
+        n_tokens = tokenize(c->line, tokens, UCI_LINE_SIZE / 2);
+
+        if (!n_tokens) {
+            /* empty line */
+        }
+        else if (!strcmp(tokens[0], "uci")) {
+            uci_send("id name smoengine");
+            uci_send("id author darksmo");
+            uci_send("option name Hash type spin default %d min 1 max 2048",
+                ENGINE_DEFAULT_HASH_MB);
+            uci_send("option name Threads type spin default 1 min 1 max 64");
+            uci_send("option name Ponder type check default false");
+            uci_send("uciok");
+        }
+        else if (!strcmp(tokens[0], "isready")) {
+            uci_send("readyok");
+        }
+        else if (!strcmp(tokens[0], "ucinewgame")) {
+            engine_clear_hash();
+        }
+        else if (!strcmp(tokens[0], "position")) {
+            cmd_position(tokens, n_tokens);
+        }
+        else if (!strcmp(tokens[0], "go")) {
+            cmd_go(tokens, n_tokens);
+        }
+        else if (!strcmp(tokens[0], "setoption")) {
+            cmd_setoption(tokens, n_tokens);
+        }
+        else if (!strcmp(tokens[0], "bench")) {
+            cmd_bench(n_tokens > 1 ? atoi(tokens[1]) : UCI_BENCH_DEPTH);
+        }
+        else if (!strcmp(tokens[0], "debug")) {
+            debug = (n_tokens > 1 && !strcmp(tokens[1], "on"));
+        }
+        else if (!strcmp(tokens[0], "profile")) {
+            if (n_tokens > 1 && !strcmp(tokens[1], "reset")) profile_reset();
+            else send_profile();
+        }
+        else if (!strcmp(tokens[0], "quit")) {
+            quit = 1;
+        }
+        free(c);
+    }
+
+    if (board) destroy_bitboard(board);
+    return 0;
+}